@@ -0,0 +1,112 @@
+#!/bin/sh
+# Benchmark dos dois resolvedores (sokoban-sequencial.x e sokoban-paralelizado.x).
+#
+# Uso: bench/bench.sh [resultados.csv]
+#
+# Roda cada nível do corpus versionado e os níveis do gerador (com semente fixa) no resolvedor
+# sequencial e no paralelizado (BFS e A*, ambos ótimos em passos), este último para cada valor
+# de OMP_NUM_THREADS. Grava uma linha CSV por execução com tempo, estados visitados, estados por
+# segundo, pico de memória (KB), speedup e eficiência em relação ao sequencial no mesmo nível e o
+# comprimento da solução. Termina com erro se alguma variante der um comprimento diferente.
+#
+# Variáveis de ambiente:
+#   THREADS  valores de OMP_NUM_THREADS (padrão: potências de 2 até o número de núcleos, e ele)
+#   CORPUS   arquivo de níveis versionado (padrão: bench/corpus-v1.xsb)
+#   SEED     semente do gerador (padrão: 1)
+#   SIZES    tamanhos gerados, "larguraxalturaxcaixas" (padrão: "7x7x2 8x8x3 10x8x3 12x10x4")
+#   COUNT    níveis gerados por tamanho (padrão: 2)
+#   TIMEOUT  limite de cada execução em segundos (padrão: 600)
+
+set -eu
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+out=${1:-$root/bench/resultados.csv}
+corpus=${CORPUS:-$root/bench/corpus-v1.xsb}
+seed=${SEED:-1}
+sizes=${SIZES:-"7x7x2 8x8x3 10x8x3 12x10x4"}
+count=${COUNT:-2}
+limit=${TIMEOUT:-600}
+seq_bin=$root/sokoban-sequencial.x
+par_bin=$root/sokoban-paralelizado.x
+
+if [ -z "${THREADS:-}" ]; then
+    cores=$(nproc)
+    THREADS=1
+    t=2
+    while [ "$t" -lt "$cores" ]; do
+        THREADS="$THREADS $t"
+        t=$((t * 2))
+    done
+    [ "$cores" -gt 1 ] && THREADS="$THREADS $cores"
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# Separa os níveis de uma coleção em arquivos "$tmp/<prefixo>-<n>.xsb"
+split_levels() {
+    awk -v dir="$tmp" -v prefix="$2" '
+        { board = $0 ~ /^[ \t]*#/ }
+        board && !inside { n++; file = sprintf("%s/%s-%d.xsb", dir, prefix, n) }
+        board { print > file }
+        !board && inside { close(file) }
+        { inside = board }
+    ' "$1"
+}
+
+split_levels "$corpus" "$(basename "$corpus" .xsb)"
+for size in $sizes; do
+    set -- $(echo "$size" | tr 'x' ' ')
+    "$root/bench/gerador.x" "$seed" "$1" "$2" "$3" "$count" > "$tmp/gen.txt"
+    split_levels "$tmp/gen.txt" "gerado-s$seed-$size"
+done
+
+# Roda um resolvedor e imprime "tempo_ms estados pico_kb comprimento" (ou "- - - -" se falhar)
+measure() {
+    if timeout "$limit" "$@" > "$tmp/run.txt" 2>&1; then
+        awk '
+            /^Tempo total gasto/ { ms = $5 }
+            /^Estados visitados:/ { states = $3 }
+            /^Pico de memória:/ { kb = $4 }
+            moves { len = length($0); moves = 0 }
+            /^Movimentos:/ { moves = 1 }
+            END { print ms, states, kb, len }
+        ' "$tmp/run.txt"
+    else
+        echo "- - - -"
+    fi
+}
+
+echo "nivel,programa,modo,threads,tempo_ms,estados,estados_por_s,pico_kb,speedup,eficiencia,comprimento" > "$out"
+bad=0
+for level in $(ls "$tmp"/*.xsb | sort -V); do
+    name=$(basename "$level" .xsb)
+    set -- $(measure "$seq_bin" "$level")
+    base_ms=$1
+    ref_len=$4
+    rows="sequencial bfs 1 $*"
+    for t in $THREADS; do
+        rows="$rows
+paralelizado bfs $t $(OMP_NUM_THREADS=$t measure "$par_bin" "$level")
+paralelizado astar $t $(OMP_NUM_THREADS=$t measure "$par_bin" -a "$level")"
+    done
+
+    echo "$rows" | while read -r prog mode t ms states kb len; do
+        awk -v n="$name" -v p="$prog" -v m="$mode" -v t="$t" -v ms="$ms" -v st="$states" \
+            -v kb="$kb" -v len="$len" -v base="$base_ms" 'BEGIN {
+            if (ms == "-") { printf "%s,%s,%s,%s,,,,,,,\n", n, p, m, t; exit }
+            rate = ms > 0 ? st / (ms / 1000) : 0
+            speedup = ms > 0 && base != "-" ? base / ms : 0
+            printf "%s,%s,%s,%s,%.3f,%s,%.0f,%s,%.3f,%.3f,%s\n", n, p, m, t, ms, st, rate, kb, speedup, speedup / t, len
+        }' >> "$out"
+        if [ "$len" != "$ref_len" ] || [ "$len" = "-" ]; then
+            echo "$name: $prog $mode com $t thread(s) deu comprimento $len (sequencial: $ref_len)" >&2
+            touch "$tmp/bad"
+        fi
+    done
+    echo "$name: sequencial ${base_ms} ms, solução com $ref_len movimentos"
+done
+
+[ -e "$tmp/bad" ] && bad=1
+echo "Resultados em $out"
+exit $bad
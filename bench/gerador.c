@@ -0,0 +1,170 @@
+/*
+ * Gerador de níveis de Sokoban para o benchmark.
+ *
+ * Uso: gerador semente largura altura caixas [quantidade]
+ *
+ * Cada nível é uma sala de largura x altura (com as paredes da borda) com paredes internas
+ * sorteadas. As caixas começam nas metas e o jogador as puxa em passos aleatórios, ao contrário
+ * do jogo; a posição final vira o nível. Como cada puxada desfeita é um empurrão válido, todo
+ * nível gerado tem solução. A mesma semente gera sempre os mesmos níveis (o gerador de números
+ * é o splitmix64, que não depende da biblioteca C).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+int w, h;
+char *cell; // '#' parede, ' ' chão
+bool *goal, *box;
+
+uint64_t seed;
+
+// Gerador splitmix64 (o mesmo usado para as chaves de Zobrist do resolvedor)
+uint64_t splitmix64()
+{
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Número aleatório em [0, n)
+int rnd(int n)
+{
+    return splitmix64() % n;
+}
+
+// Sorteia as paredes e deixa só a maior região de chão conexa; retorna o número de células de chão
+int make_room()
+{
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            cell[y * w + x] = y == 0 || x == 0 || y == h - 1 || x == w - 1 || rnd(100) < 18 ? '#' : ' ';
+
+    int *region = calloc(w * h, sizeof(int)), *queue = malloc(w * h * sizeof(int));
+    int best = 0, best_size = 0, n_regions = 0;
+    const int offsets[4] = {1, -1, w, -w};
+    for (int i = 0; i < w * h; i++)
+    {
+        if (cell[i] != ' ' || region[i])
+            continue;
+        int head = 0, tail = 0;
+        region[i] = ++n_regions;
+        queue[tail++] = i;
+        while (head < tail)
+        {
+            const int c = queue[head++];
+            for (int d = 0; d < 4; d++)
+            {
+                const int n = c + offsets[d];
+                if (cell[n] == ' ' && !region[n])
+                    region[n] = n_regions, queue[tail++] = n;
+            }
+        }
+        if (tail > best_size)
+            best = n_regions, best_size = tail;
+    }
+    for (int i = 0; i < w * h; i++)
+        if (cell[i] == ' ' && region[i] != best)
+            cell[i] = '#';
+
+    free(region);
+    free(queue);
+    return best_size;
+}
+
+// Célula de chão livre sorteada
+int random_free()
+{
+    int c;
+    do
+        c = rnd(w * h);
+    while (cell[c] != ' ' || box[c]);
+    return c;
+}
+
+// Gera um nível com n_boxes caixas e o imprime no formato XSB
+void generate(int n_boxes, int index)
+{
+    const int offsets[4] = {1, -1, w, -w};
+    const int steps = 40 * n_boxes * (w + h);
+    int player;
+    bool solved = true;
+    while (solved) // Repete até alguma caixa sair da meta
+    {
+        while (make_room() < n_boxes * 3 + 4)
+            ;
+        memset(goal, 0, w * h * sizeof(bool));
+        memset(box, 0, w * h * sizeof(bool));
+        for (int k = 0; k < n_boxes; k++)
+        {
+            const int c = random_free();
+            goal[c] = box[c] = true;
+        }
+        player = random_free();
+
+        // Passos aleatórios para trás: andar, ou puxar a caixa que está atrás do jogador
+        for (int k = 0; k < steps; k++)
+        {
+            const int d = rnd(4), to = player + offsets[d], behind = player - offsets[d];
+            if (cell[to] != ' ' || box[to])
+                continue;
+            if (box[behind] && rnd(2))
+                box[behind] = false, box[player] = true;
+            player = to;
+        }
+
+        for (int c = 0; c < w * h; c++)
+            solved &= !box[c] || goal[c];
+    }
+
+    printf("; %d (%dx%d, %d caixas)\n\n", index, w, h, n_boxes);
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            const int c = y * w + x;
+            if (c == player)
+                putchar(goal[c] ? '+' : '@');
+            else if (box[c])
+                putchar(goal[c] ? '*' : '$');
+            else
+                putchar(goal[c] ? '.' : cell[c]);
+        }
+        putchar('\n');
+    }
+    putchar('\n');
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        fprintf(stderr, "Uso: %s semente largura altura caixas [quantidade]\n", argv[0]);
+        return 2;
+    }
+    seed = strtoull(argv[1], NULL, 10);
+    w = atoi(argv[2]);
+    h = atoi(argv[3]);
+    const int n_boxes = atoi(argv[4]);
+    const int count = argc > 5 ? atoi(argv[5]) : 1;
+    if (w < 4 || h < 4 || n_boxes < 1 || (w - 2) * (h - 2) < n_boxes * 3 + 4)
+    {
+        fprintf(stderr, "Sala pequena demais para %d caixas\n", n_boxes);
+        return 2;
+    }
+
+    cell = malloc(w * h);
+    goal = malloc(w * h * sizeof(bool));
+    box = malloc(w * h * sizeof(bool));
+    for (int i = 1; i <= count; i++)
+        generate(n_boxes, i);
+
+    free(cell);
+    free(goal);
+    free(box);
+    return 0;
+}
@@ -3,28 +3,47 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <assert.h>
 #include <stdbool.h>
 
 #include <omp.h>
 #include <sys/time.h>
 #include <math.h>
-
-int w, h, n_boxes;             // largura (w), altura (h) e número de caixas (n_boxes)
-uint8_t *board, *goals, *live; // Ponteiros para o tabuleiro, metas e células "vivas"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <getopt.h>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+#include "sokoban.h"
 
 typedef uint16_t cidx_t; // Tipo para index de célula
-typedef uint32_t hash_t; // Tipo para hash (função de dispersão)
+typedef uint64_t hash_t; // Tipo para hash (função de dispersão)
+typedef uint32_t sidx_t; // Tipo para índice de estado nas arenas (0 = nenhum estado)
 
 /* A configuração do tabuleiro é representada por um array de índices de células
-   do jogador e das caixas */
+   do jogador e das caixas. O registro guarda só o necessário para refazer o caminho e decidir
+   o dono na BFS: o hash fica na camada e na tabela, e os estados são referenciados por índice
+   de 32 bits (ver state_at), então o cabeçalho tem 12 bytes em vez de 32. */
 typedef struct state_t state_t;
 
 struct state_t
-{                                 // estrutura para identificar o estado do jogo
-    hash_t h;                     // hash para o estado (usado para otimização)
-    state_t *prev, *next, *qnext; // ponteiros para o estado anterior, próximo e próximo na fila,  cria uma lista ligada para estados explorados ou a explorar
-    cidx_t c[];                   // array de índices de células (posição do jogador e das caixas)
+{                          // estrutura para identificar o estado do jogo
+    union
+    {
+        uint64_t owner;    // BFS: menor chave (camada, pai, direção) que gerou o estado, ver expand_level
+        uint64_t g;        // A*: menor custo conhecido desde o início, ver astar
+        sidx_t next;       // Na lista livre: próximo estado livre da thread
+#ifdef USE_MPI
+        uint64_t from_rank; // BFS distribuída, depois da camada: processo MPI do pai, ver mpi_expand
+#endif
+    };
+    sidx_t prev;           // índice do estado anterior (0 no estado inicial)
+    cidx_t c[];            // array de índices de células (posição do jogador e das caixas)
 };
 
 // Definições de tipos de células no tabuleiro
@@ -36,51 +55,619 @@ enum
     box     // caixa
 };
 
-size_t state_size, block_size = 32; // Tamanho do estado e tamanho do bloco para alocação
-state_t *block_root, *block_head;   // Ponteiros para a raiz e cabeça do bloco de memória para os estados
-
 /*--------------------- Funções Principais ---------------------*/
 
 /*----------- Gerenciamento de Estados -----------*/
 
-// Função que retorna o próximo estado alocado
-state_t *next_of(state_t *s)
+/* Cada thread tem sua própria arena: os estados são cortados em sequência de blocos grandes
+   (slabs) da thread, e os estados repetidos voltam para a lista livre da própria thread. Assim
+   a alocação nunca trava nem escreve em memória compartilhada. Só a obtenção de um bloco novo,
+   que é rara, passa por uma seção crítica, para registrar o bloco no diretório slab_dir.
+   Cada bloco tem SLAB_STATES estados, e o índice de um estado é (número do bloco, posição). */
+#define SLAB_SHIFT 16                              // log2 dos estados por bloco
+#define SLAB_STATES (1 << SLAB_SHIFT)              // Estados em cada bloco
+#define MAX_SLABS ((size_t)1 << (32 - SLAB_SHIFT)) // Blocos endereçáveis com índice de 32 bits
+
+typedef struct
+{
+    size_t cur, end;    // Índices ainda não usados do bloco atual
+    sidx_t free_list;   // Estados devolvidos por unnewstate, reaproveitados primeiro
+    size_t allocated;   // Estados entregues por newstate
+    size_t recycled;    // Estados devolvidos por unnewstate
+    size_t slabs;       // Blocos obtidos por esta thread
+} arena_t;
+
+// Sucessor gerado durante a expansão de uma camada, com a chave de quem o gerou
+typedef struct
+{
+    uint64_t key; // chave (camada, pai, direção) desta geração
+    hash_t h;     // hash do estado
+    sidx_t ref;   // registro do estado na arena
+} cand_t;
+
+// Testes de deadlock feitos a cada empurrão (ver deadlocked); cada um pode ser desligado com -d
+enum
+{
+    DL_FREEZE, // caixa congelada nos dois eixos fora de uma meta
+    DL_SQUARE, // bloco 2x2 de caixas e paredes com alguma caixa fora de meta
+    DL_MATCH,  // não há emparelhamento de cada caixa com uma meta distinta alcançável
+    N_DEADLOCK
+};
+
+#ifdef TELEMETRY
+/* Telemetria (compilada só com -DTELEMETRY, ver "make telemetria"): cada thread conta o que fez na
+   camada atual, e expand_level junta os contadores num registro por camada e num intervalo por
+   thread para o trace. Sem a macro, TELE some e nada disso é compilado. */
+typedef struct
+{
+    size_t generated;   // sucessores gerados
+    size_t duplicates;  // sucessores que já estavam na tabela
+    size_t live_pruned; // empurrões descartados pelo live[]
+    size_t probes;      // posições visitadas nas sondagens da tabela
+    size_t accesses;    // consultas e inserções na tabela
+    double start, end;  // início e fim do trabalho da thread na camada (omp_get_wtime)
+} tele_t;
+
+#define TELE(field, n) (sk->workers[omp_get_thread_num()].tele.field += (n))
+
+// Totais de uma camada expandida
+typedef struct
+{
+    int depth;            // profundidade da camada gerada
+    bool backward;        // lado para trás da busca bidirecional
+    size_t frontier;      // estados expandidos
+    size_t kept;          // estados da camada gerada
+    tele_t sum;           // contadores somados de todas as threads
+    size_t dl_pruned;     // estados descartados pelos testes de deadlock
+    double expand_ms;     // tempo da expansão (fases 1 e 2 de expand_level)
+    double table_ms;      // tempo de reserve_table antes da expansão
+} layer_stats_t;
+
+// Trabalho de uma thread numa camada (um evento do trace)
+typedef struct
+{
+    int thread, depth;
+    bool backward;
+    double start, end;
+} span_t;
+#else
+#define TELE(field, n) ((void)0)
+#endif
+
+// Dados de cada thread (um por thread, indexado por omp_get_thread_num)
+// Alinhado à linha de cache para que threads vizinhas não disputem a mesma linha
+typedef struct
+{
+    arena_t arena;  // Arena de estados da thread
+    cand_t *cand;   // Sucessores gerados pela thread na camada atual
+    size_t n_cand;  // Quantidade de sucessores em cand
+    size_t cap_cand; // Capacidade de cand
+    uint8_t *occ;   // 1 onde há caixa no estado sendo expandido (modo de empurrões)
+    uint8_t *seen;  // Células alcançadas pelo jogador no estado sendo expandido
+    uint8_t *seen2; // Células alcançadas no sucessor (normalização)
+    cidx_t *queue;  // Fila do flood fill
+    cidx_t *succ;   // Posições do sucessor sendo gerado (move_me, move_box)
+    uint8_t *mark;  // Caixas em análise no teste de congelamento (tratadas como parede)
+    int *match_box; // Caixa emparelhada com cada meta (0 = livre)
+    uint8_t *match_seen; // Metas já tentadas no caminho de aumento atual
+    int *hung;      // Vetores do algoritmo húngaro: u, v, p, way e minv (ver matching_cost)
+    bool *hung_used; // Colunas já usadas no algoritmo húngaro
+    int *pdb_cand;  // Grupos de caixas com ganho no banco de padrões (ver pdb_cost)
+    size_t expanded; // Estados expandidos pelo IDA* nesta thread
+    size_t pruned[N_DEADLOCK]; // Estados descartados por cada teste de deadlock
+#ifdef USE_MPI
+    uint8_t *out;   // Sucessores a enviar aos processos donos (registros mpi_rec_t, ver mpi_queue)
+    size_t n_out;   // Quantidade de registros em out
+    size_t cap_out; // Capacidade de out
+#endif
+#ifdef TELEMETRY
+    tele_t tele; // Contadores da camada atual
+#endif
+} __attribute__((aligned(64))) worker_t;
+
+// Tabela de hash de estados visitados (ver "Tabela Hash")
+typedef uint64_t slot_t;
+
+typedef struct
+{
+    slot_t *slots;     // vetor de posições da tabela
+    size_t size;       // capacidade (potência de 2)
+    size_t filled;     // número de estados inseridos
+    int bits;          // log2(size)
+    slot_t *old;       // vetor anterior, ainda em migração (NULL se não há)
+    size_t old_size;   // capacidade de old
+    int old_bits;      // log2(old_size)
+    size_t next_chunk; // início do próximo trecho de old a migrar
+    size_t moved;      // posições de old já migradas
+} table_t;
+
+// Camada da busca (ver "Fronteira da busca")
+typedef struct
+{
+    cidx_t *cells;    // posições de cada estado, uma linha de (1 + n_boxes) por estado
+    hash_t *hashes;   // hash de cada estado
+    sidx_t *refs;     // registro de cada estado na arena
+    uint32_t *parent; // índice do pai na camada anterior
+    size_t n;         // quantidade de estados na camada
+} frontier_t;
+
+/* Um lado da busca: tabela de visitados, camada atual e sua profundidade. A busca normal usa só
+   o lado para frente (fwd); a bidirecional (-b) alterna entre ele e o lado para trás (bwd), que
+   parte das metas puxando caixas, e o objetivo de cada lado passa a ser encontrar o outro. */
+typedef struct search_t search_t;
+
+struct search_t
+{
+    table_t table;    // estados visitados por este lado
+    frontier_t level; // camada sendo expandida
+    int depth;        // profundidade da camada em level
+    bool backward;    // puxa caixas a partir das metas em vez de empurrar
+    search_t *other;  // lado oposto na busca bidirecional (NULL na busca normal)
+};
+
+// Variáveis de controle de níveis e soluções
+
+// Entrada da fila de prioridade: f = g + h, o g com que o estado entrou e o estado
+typedef struct
+{
+    uint32_t f, g;
+    sidx_t s;
+} node_t;
+
+/* Contexto de uma resolução (sokoban_t, ver sokoban.h): o nível, a análise estática, as arenas e
+   tabelas, as opções e o resultado de cada motor. Cada thread que resolve um nível aponta sk para
+   o seu contexto, e cada região paralela o copia para as threads da equipe (copyin), então várias
+   resoluções podem correr ao mesmo tempo no mesmo processo, cada uma com as suas threads e a sua
+   memória, sem nenhuma trava entre elas. */
+struct sokoban
+{
+    // Nível
+    int w, h, n_boxes;             // largura (w), altura (h) e número de caixas (n_boxes)
+    uint8_t *board, *goals, *live; // Ponteiros para o tabuleiro, metas e células "vivas"
+    int offsets[4];                // deslocamento de índice para direita, esquerda, cima e baixo (preenchido em solve)
+    int start_player;              // posição real do jogador no início (o estado inicial guarda a canônica)
+    const char *level_text;        // nível sendo resolvido (string retangular de pad_level)
+    hash_t *zobrist_player, *zobrist_box; // chaves de Zobrist de cada célula (ver init_zobrist)
+
+    // Arenas e memória (ver "Gerenciamento de Estados")
+    size_t state_size;    // Tamanho do estado (cabeçalho mais as posições), alinhado a 8 bytes
+    worker_t *workers;    // Dados de cada thread da equipe
+    int n_workers;
+    size_t n_slabs;       // Quantidade de blocos registrados em slab_dir
+    size_t mem_limit;     // Limite para blocos e tabelas, em bytes (-M; 0 = sem limite)
+    size_t mem_used;      // Memória em uso por blocos e tabelas
+    uint8_t *slab_region; // Faixa reservada para os blocos (NULL: ainda não reservada ou blocos com malloc)
+    size_t slab_reserved; // Tamanho da faixa reservada
+    bool slab_malloc;     // A reserva falhou (ulimit -v, por exemplo): cada bloco vem do malloc
+
+    // Análise estática do nível (ver "Detecção de deadlocks", "Macros" e "Cache da análise do nível")
+    unsigned deadlock_checks; // bit k ligado: teste k ativo (-d)
+    int n_goals;
+    int *goal_cells;     // células das metas
+    uint16_t *goal_dist; // goal_dist[g * w * h + c]: empurrões para levar uma caixa de c até a meta g
+    int *neighbor;       // neighbor[c * 4 + d]: célula vizinha de c na direção d, ou -1 se for parede ou fora do tabuleiro
+    bool macros;         // empurrões em macro (-u)
+    uint8_t *corridor;   // corridor[c]: bit 0 com paredes à esquerda e à direita de c, bit 1 acima e abaixo
+    int *room_of;        // sala (1 a n_rooms) de cada célula, ou 0
+    int *door_of;        // sala de que a célula é a porta, ou 0
+    int *goal_rank;      // posição da meta na ordem de preenchimento da sua sala, ou -1
+    int n_rooms;
+    int *room_first;     // metas da sala r (1 a n_rooms) em room_seq[room_first[r - 1] .. room_first[r] - 1]
+    int *room_seq;       // metas de cada sala na ordem de preenchimento
+    int *room_macro;     // room_macro[(i * 4 + d) * 2]: onde o jogador termina ao levar a caixa da porta até
+                         // a meta room_seq[i] entrando na direção d (-1 se não dá), e [+ 1] os empurrões
+    const char *cache_dir; // diretório do cache da análise (-k; NULL = sem cache)
+    uint8_t *cache_map;    // arquivo de cache mapeado, para onde apontam os vetores da análise
+    size_t cache_size;     // tamanho do mapeamento
+
+    // Busca em largura (ver "Fronteira da busca", "Modo de empurrões" e "Busca bidirecional")
+    bool push_mode;            // busca por empurrões (-p)
+    bool bidirectional;        // busca bidirecional (-b)
+    search_t fwd, bwd;         // lados da busca
+    uint64_t best_key;         // menor chave que gerou um estado final na camada seguinte
+    sidx_t done;               // estado final encontrado
+    search_t *done_side;       // lado em que done foi gerado
+    int lean;                  // busca só com a fronteira (-l): camadas anteriores guardadas, ou 0 (ver lean_search)
+    const cidx_t *lean_target; // posições procuradas pela busca só com a fronteira (NULL: qualquer estado final)
+    table_t *lean_window;      // tabelas das camadas anteriores, da mais antiga para a mais nova (lean camadas)
+    cidx_t *lean_path;         // solução: posições de cada estado, do início ao final
+    int lean_len;              // estados em lean_path
+    size_t lean_visited;       // estados gerados somando todas as buscas
+
+    // Checkpoints (ver "Checkpoints da busca em largura")
+    const char *ckp_path;    // checkpoints gravados neste arquivo (-c)
+    const char *resume_path; // checkpoint de onde a busca continua (-r)
+    double ckp_interval;     // segundos entre checkpoints (-s)
+    pthread_t ckp_thread;
+    bool ckp_running;        // há uma gravação iniciada e ainda não aguardada
+    int ckp_busy;            // a gravação ainda não terminou (lido e escrito com atômicos)
+    double ckp_last;         // instante (omp_get_wtime) do último checkpoint iniciado
+
+#ifdef USE_MPI
+    // Busca distribuída (ver "Busca distribuída (MPI)")
+    bool distributed;               // busca em largura distribuída entre processos MPI (ver mpi_bfs)
+    size_t mpi_rec_size;            // bytes de um registro mpi_rec_t (alinhado a 8)
+    MPI_Datatype mpi_rec_type;      // registro mpi_rec_t como tipo MPI
+    cidx_t *mpi_path;               // solução: posições de cada estado, do início ao final
+    int mpi_len;                    // estados em mpi_path
+    unsigned long long *mpi_filled; // estados na tabela de cada processo
+    size_t mpi_visited;             // estados visitados somando todos os processos
+#endif
+
+    // Busca em memória externa (ver "Busca em memória externa")
+    bool external;             // busca em disco (-e)
+    const char *ext_dir;       // diretório dos arquivos de camada, corridas e visitados
+    size_t ext_budget;         // memória para os buffers de sucessores (-m, em bytes)
+    size_t ext_visited;        // estados gravados em todas as camadas
+    char *ext_solution;        // solução encontrada (letras, terminada em '\n')
+    size_t key_size, rec_size; // bytes das posições e do registro (posições mais o movimento)
+    char **ext_runs;           // corridas da camada sendo expandida
+    size_t n_ext_runs, cap_ext_runs;
+
+    // Bancos de padrões (ver "Bancos de padrões")
+    int pdb_k;          // caixas por padrão (-g; 0 = sem banco)
+    int pdb_live;       // quantidade de casas vivas (posições de uma caixa)
+    int pdb_floor;      // quantidade de casas de chão (posições do jogador)
+    int *pdb_live_idx;  // índice de cada célula entre as vivas (-1 se morta)
+    int *pdb_floor_idx; // índice de cada célula entre as de chão (-1 se parede)
+    size_t *pdb_binom;  // pdb_binom[n * (pdb_k + 1) + r] = C(n, r), para n até pdb_live
+    uint8_t *pdb;       // pdb[conjunto * pdb_floor + jogador]: empurrões + 1, ou 0 se inalcançável
+    size_t pdb_bytes;   // tamanho de pdb
+    size_t pdb_states;  // estados (caixas e região do jogador) alcançados na construção
+    double pdb_ms;      // tempo da construção (ou da leitura do cache)
+    uint8_t *pdb_map;    // arquivo do banco mapeado
+    size_t pdb_map_size; // tamanho do mapeamento
+
+    // Busca A* (ver "Busca A*")
+    bool astar_mode;                   // busca A* (-a)
+    node_t *heap;                      // fila de prioridade
+    size_t heap_n, heap_cap, expanded; // entradas na fila, capacidade e estados expandidos
+
+    // Busca IDA* (ver "Busca IDA*")
+    bool ida_mode;      // busca IDA* (-i)
+    uint64_t *tt;       // tabela de transposição
+    size_t tt_mask;     // tamanho da tabela - 1 (potência de 2)
+    uint64_t tt_tag;    // etiqueta da iteração atual (1 a 255)
+    int ida_bound;      // limite de f da iteração atual
+    int ida_next;       // menor f acima do limite visto na iteração
+    int ida_pending;    // tarefas criadas que ainda não começaram
+    bool ida_found;     // alguma tarefa achou a solução
+    cidx_t *ida_path;   // caminho da solução: ida_len linhas de (1 + n_boxes) posições
+    int ida_len;
+    size_t ida_visited; // estados expandidos em todas as iterações
+
+#ifdef TELEMETRY
+    // Telemetria (ver "Telemetria")
+    layer_stats_t *layer_stats;
+    span_t *spans;
+    size_t n_layer_stats, cap_layer_stats, n_spans, cap_spans;
+    double tele_t0, tele_last; // início da busca e última linha de progresso
+    const char *trace_path;    // arquivo do trace (-t)
+#endif
+
+    bool failed;                  // a busca parou por um erro (mensagem já em stderr)
+    unsigned id;                  // número do contexto no processo (nomes dos arquivos temporários)
+    uint8_t *slab_dir[MAX_SLABS]; // Todos os blocos de estados, de todas as threads, pelo número
+};
+
+static sokoban_t *sk; // Contexto da resolução da thread (as regiões paralelas o recebem com copyin)
+#pragma omp threadprivate(sk)
+
+// Registro do estado de índice i
+static inline state_t *state_at(sidx_t i)
+{
+    return (state_t *)(sk->slab_dir[i >> SLAB_SHIFT] + (size_t)(i & (SLAB_STATES - 1)) * sk->state_size);
+}
+
+// Aloca memória alinhada à linha de cache (aligned_alloc exige tamanho múltiplo do alinhamento)
+void *alloc_aligned(size_t bytes)
+{
+    return aligned_alloc(64, bytes ? (bytes + 63) / 64 * 64 : 64);
+}
+
+/* Os blocos das arenas saem de uma única faixa de endereços reservada com mmap no primeiro bloco,
+   sem memória por trás (PROT_NONE), e liberada para escrita bloco a bloco com mprotect. A faixa
+   pede páginas enormes transparentes (MADV_HUGEPAGE), assim como os vetores grandes das tabelas de
+   hash, o que reduz as falhas de TLB nos acessos aleatórios de lookup e de state_at. Com -M,
+   blocos e tabelas juntos não passam do limite dado, e a faixa reservada tem o tamanho dele. */
+#define HUGE_PAGE ((size_t)2 << 20) // Página enorme (2 MiB em x86-64 e arm64)
+
+// Conta mais `bytes` em uso; encerra o programa se passar do limite de -M
+void mem_charge(size_t bytes)
+{
+    const size_t used = __atomic_add_fetch(&sk->mem_used, bytes, __ATOMIC_RELAXED);
+    if (!sk->mem_limit || used <= sk->mem_limit)
+        return;
+    fprintf(stderr, "Limite de memória de %zu MiB (-M) excedido\n", sk->mem_limit >> 20);
+#ifdef USE_MPI
+    _exit(3); // Sem MPI_Finalize, que travaria esperando os outros processos: o mpirun encerra todos
+#else
+    exit(3);
+#endif
+}
+
+// Mapeia `bytes` alinhados à página enorme, com páginas enormes transparentes; retorna NULL se falhar
+void *map_huge(size_t bytes, int prot)
+{
+    uint8_t *p = mmap(NULL, bytes + HUGE_PAGE, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    // Mapeia uma página enorme a mais e devolve as sobras antes e depois do trecho alinhado
+    uint8_t *a = (uint8_t *)(((uintptr_t)p + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1));
+    if (a > p)
+        munmap(p, a - p);
+    munmap(a + bytes, p + HUGE_PAGE - a);
+#ifdef MADV_HUGEPAGE
+    madvise(a, bytes, MADV_HUGEPAGE);
+#endif
+    return a;
+}
+
+// Memória do bloco de número k; retorna NULL se não houver memória
+uint8_t *slab_memory(size_t k)
+{
+    const size_t bytes = (size_t)SLAB_STATES * sk->state_size;
+    mem_charge(bytes);
+
+    if (!sk->slab_region && !sk->slab_malloc)
+    {
+        // Reserva o limite de -M ou, sem ele, o espaço de todos os blocos endereçáveis
+        sk->slab_reserved = ((sk->mem_limit ? sk->mem_limit : MAX_SLABS * bytes) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+        sk->slab_region = map_huge(sk->slab_reserved, PROT_NONE);
+        sk->slab_malloc = !sk->slab_region;
+    }
+    if (sk->slab_malloc)
+        return malloc(bytes);
+
+    uint8_t *slab = sk->slab_region + k * bytes; // mem_charge garante que o bloco cabe na faixa
+    return mprotect(slab, bytes, PROT_READ | PROT_WRITE) ? NULL : slab;
+}
+
+// Vetor zerado de `bytes` para tabelas de hash: os grandes são mapeados à parte, com páginas enormes
+void *table_alloc(size_t bytes)
+{
+    mem_charge(bytes);
+    return bytes < HUGE_PAGE ? calloc(bytes, 1) : map_huge(bytes, PROT_READ | PROT_WRITE);
+}
+
+// Libera um vetor de table_alloc com `bytes`
+void table_release(void *p, size_t bytes)
+{
+    if (!p)
+        return;
+    __atomic_sub_fetch(&sk->mem_used, bytes, __ATOMIC_RELAXED);
+    if (bytes < HUGE_PAGE)
+        free(p);
+    else
+        munmap(p, bytes);
+}
+
+// Aloca os dados de todas as threads (precisa de w e h)
+void init_workers()
+{
+    sk->n_workers = omp_get_max_threads();
+    sk->workers = alloc_aligned(sk->n_workers * sizeof(worker_t));
+    assert(sk->workers);
+    memset(sk->workers, 0, sk->n_workers * sizeof(worker_t));
+    for (int t = 0; t < sk->n_workers; t++)
+    {
+        sk->workers[t].occ = calloc(sk->w * sk->h, sizeof(uint8_t));
+        sk->workers[t].seen = calloc(sk->w * sk->h, sizeof(uint8_t));
+        sk->workers[t].seen2 = calloc(sk->w * sk->h, sizeof(uint8_t));
+        sk->workers[t].queue = malloc(sk->w * sk->h * sizeof(cidx_t));
+        sk->workers[t].succ = malloc((sk->w * sk->h + 1) * sizeof(cidx_t)); // Cabe qualquer quantidade de caixas
+        sk->workers[t].mark = calloc(sk->w * sk->h, sizeof(uint8_t));
+        assert(sk->workers[t].occ && sk->workers[t].seen && sk->workers[t].seen2 && sk->workers[t].queue && sk->workers[t].succ && sk->workers[t].mark);
+    }
+}
+
+// Mostra quantos estados cada thread alocou e reaproveitou
+void print_arena_stats()
+{
+    for (int t = 0; t < sk->n_workers; t++)
+    {
+        const arena_t *a = &sk->workers[t].arena;
+        printf("Thread %d: %zu estados alocados, %zu reaproveitados, %zu blocos\n",
+               t, a->allocated, a->recycled, a->slabs);
+    }
+}
+
+// Mostra quantos estados cada teste de deadlock descartou, somando todas as threads
+void print_deadlock_stats()
+{
+    static const char *names[N_DEADLOCK] = {"congelamento", "bloco 2x2", "emparelhamento"};
+    printf("Podas por deadlock:");
+    for (int k = 0; k < N_DEADLOCK; k++)
+    {
+        size_t total = 0;
+        for (int t = 0; t < sk->n_workers; t++)
+            total += sk->workers[t].pruned[k];
+        printf("%s %s %zu", k ? "," : "", names[k], total);
+    }
+    printf("\n");
+}
+
+// Libera os dados das threads e, numa única passada, todos os blocos de estados
+void free_workers()
+{
+    if (sk->slab_region)
+        munmap(sk->slab_region, sk->slab_reserved);
+    else
+        for (size_t i = 0; i < sk->n_slabs; i++)
+            free(sk->slab_dir[i]);
+    sk->mem_used -= sk->n_slabs * SLAB_STATES * sk->state_size;
+    sk->slab_region = NULL, sk->slab_malloc = false;
+    sk->n_slabs = 0;
+
+    for (int t = 0; t < sk->n_workers; t++)
+    {
+        free(sk->workers[t].cand);
+        free(sk->workers[t].occ);
+        free(sk->workers[t].seen);
+        free(sk->workers[t].seen2);
+        free(sk->workers[t].queue);
+        free(sk->workers[t].succ);
+        free(sk->workers[t].mark);
+        free(sk->workers[t].match_box);
+        free(sk->workers[t].match_seen);
+        free(sk->workers[t].hung);
+        free(sk->workers[t].hung_used);
+        free(sk->workers[t].pdb_cand);
+#ifdef USE_MPI
+        free(sk->workers[t].out);
+#endif
+    }
+    free(sk->workers);
+}
+
+#ifdef TELEMETRY
+/*----------- Telemetria -----------*/
+
+// Soma das podas por deadlock de todas as threads
+size_t total_dl_pruned()
+{
+    size_t total = 0;
+    for (int t = 0; t < sk->n_workers; t++)
+        for (int k = 0; k < N_DEADLOCK; k++)
+            total += sk->workers[t].pruned[k];
+    return total;
+}
+
+// Zera os contadores das threads antes de expandir uma camada
+void tele_begin_layer()
+{
+    for (int t = 0; t < sk->n_workers; t++)
+        memset(&sk->workers[t].tele, 0, sizeof(tele_t));
+}
+
+// Junta os contadores das threads no registro da camada e guarda o intervalo de cada thread
+void tele_end_layer(layer_stats_t *ls)
+{
+    for (int t = 0; t < sk->n_workers; t++)
+    {
+        const tele_t *te = &sk->workers[t].tele;
+        ls->sum.generated += te->generated;
+        ls->sum.duplicates += te->duplicates;
+        ls->sum.live_pruned += te->live_pruned;
+        ls->sum.probes += te->probes;
+        ls->sum.accesses += te->accesses;
+        if (!te->start)
+            continue; // A thread não pegou nenhuma faixa
+        if (sk->n_spans == sk->cap_spans)
+        {
+            sk->cap_spans = sk->cap_spans ? sk->cap_spans * 2 : 1024;
+            sk->spans = realloc(sk->spans, sk->cap_spans * sizeof(span_t));
+            assert(sk->spans);
+        }
+        sk->spans[sk->n_spans++] = (span_t){t, ls->depth, ls->backward, te->start, te->end};
+    }
+
+    if (sk->n_layer_stats == sk->cap_layer_stats)
+    {
+        sk->cap_layer_stats = sk->cap_layer_stats ? sk->cap_layer_stats * 2 : 64;
+        sk->layer_stats = realloc(sk->layer_stats, sk->cap_layer_stats * sizeof(layer_stats_t));
+        assert(sk->layer_stats);
+    }
+    sk->layer_stats[sk->n_layer_stats++] = *ls;
+}
+
+// Linha de progresso em stderr, no máximo uma por segundo
+void tele_progress(int depth, size_t frontier, size_t visited)
+{
+    const double now = omp_get_wtime();
+    if (now - sk->tele_last < 1)
+        return;
+    sk->tele_last = now;
+    fprintf(stderr, "[%.1f s] profundidade %d: fronteira %zu, visitados %zu (%.0f estados/s)\n",
+            now - sk->tele_t0, depth, frontier, visited, visited / (now - sk->tele_t0));
+}
+
+// Resumo por camada
+void print_layer_stats()
+{
+    printf("\n%5s %4s %10s %11s %11s %10s %10s %9s %10s %9s\n", "prof", "lado", "fronteira", "gerados",
+           "repetidos", "podas live", "podas dl", "sondagens", "expansão", "tabela");
+    for (size_t i = 0; i < sk->n_layer_stats; i++)
+    {
+        const layer_stats_t *ls = &sk->layer_stats[i];
+        printf("%5d %4s %10zu %11zu %11zu %10zu %10zu %9.2f %8.1f ms %6.1f ms\n", ls->depth,
+               ls->backward ? "trás" : "frente", ls->frontier, ls->sum.generated, ls->sum.duplicates,
+               ls->sum.live_pruned, ls->dl_pruned, ls->sum.accesses ? (double)ls->sum.probes / ls->sum.accesses : 0,
+               ls->expand_ms, ls->table_ms);
+    }
+}
+
+// Grava o trace no formato de eventos do Chrome (chrome://tracing, Perfetto): um evento por thread por camada
+void write_trace(const char *path)
 {
-    return (void *)((uint8_t *)s + state_size); // Retorna a posição do próximo estado
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        perror(path);
+        return;
+    }
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < sk->n_spans; i++)
+    {
+        const span_t *sp = &sk->spans[i];
+        fprintf(f, "%s{\"name\":\"camada %d\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                   "\"ts\":%.1f,\"dur\":%.1f}",
+                i ? ",\n" : "", sp->depth, sp->backward ? "tras" : "frente", sp->thread,
+                (sp->start - sk->tele_t0) * 1e6, (sp->end - sp->start) * 1e6);
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(f);
 }
+#endif
 
-// Função para criar um novo estado, baseado em um estado pai
-state_t *newstate(state_t *parent)
+// Obtém um bloco novo para a arena e o registra em slab_dir (o número do bloco fixa o lugar dele na faixa)
+void new_slab(arena_t *a)
 {
-    state_t *ptr;
-    if (!block_head)
+    size_t k;
+#pragma omp critical(blocos)
     {
-        block_size *= 2;                              // Dobra o tamanho do bloco de memória
-        state_t *p = malloc(block_size * state_size); // Aloca o bloco de memória
-        assert(p);
-        p->next = block_root;
-        block_root = p;
-        ptr = (void *)((uint8_t *)p + state_size * block_size);
-        p = block_head = next_of(p);
-        state_t *q;
-        for (q = next_of(p); q < ptr; p = q, q = next_of(q))
-            p->next = q;
-        p->next = NULL;
+        k = sk->n_slabs++;
+        assert(k < MAX_SLABS); // Mais de 2^32 estados
+        sk->slab_dir[k] = slab_memory(k);
+        assert(sk->slab_dir[k]);
     }
 
-    ptr = block_head;
-    block_head = block_head->next;
+    a->cur = k << SLAB_SHIFT;
+    a->end = a->cur + SLAB_STATES;
+    if (!a->cur)
+        a->cur = 1; // O índice 0 significa "nenhum estado"
+    a->slabs++;
+}
+
+// Função para criar um novo estado, baseado em um estado pai; retorna o índice do estado
+// Usa a arena da thread que chama: primeiro a lista livre, depois o bloco atual
+sidx_t newstate(sidx_t parent)
+{
+    arena_t *a = &sk->workers[omp_get_thread_num()].arena;
+    sidx_t i = a->free_list;
+
+    if (i)
+        a->free_list = state_at(i)->next;
+    else
+    {
+        if (a->cur == a->end)
+            new_slab(a);
+        i = a->cur++;
+    }
 
-    ptr->prev = parent; // Define o estado anterior
-    ptr->h = 0;         // Inicializa o hash
-    return ptr;
+    a->allocated++;
+    state_at(i)->prev = parent; // Define o estado anterior
+    return i;
 }
 
-// Função para liberar um estado e devolver para a lista de estados disponíveis
-void unnewstate(state_t *p)
+// Função para liberar um estado e devolver para a lista livre da thread que chama
+void unnewstate(sidx_t i)
 {
-    p->next = block_head;
-    block_head = p;
+    arena_t *a = &sk->workers[omp_get_thread_num()].arena;
+    state_at(i)->next = a->free_list;
+    a->free_list = i;
+    a->recycled++;
 }
 
 /*----------- Manipulação de Tabuleiro -----------*/
@@ -95,7 +682,7 @@ void mark_live_iterative(const int start)
     // #pragma omp parallel
     {
         // Declara a pilha e o índice superior (top) para controle da pilha
-        int stack[w * h];
+        int stack[sk->w * sk->h];
         int top = -1;
 
         // Adiciona o ponto inicial à pilha
@@ -108,51 +695,65 @@ void mark_live_iterative(const int start)
             int c = stack[top--];
 
             // Calcula as coordenadas (y, x) a partir do índice linear c
-            const int y = c / w, x = c % w;
+            const int y = c / sk->w, x = c % sk->w;
 
             // Se a célula já foi marcada como viva, ignora esta iteração
-            if (live[c])
+            if (sk->live[c])
                 continue;
 
 // Marca a célula atual como viva
 #pragma omp atomic write
-            live[c] = 1;
+            sk->live[c] = 1;
 
             // Verifica as células vizinhas e as adiciona à pilha, se possível
             // Verificação para célula acima (y > 1 para evitar índice fora do limite superior)
-            if (y > 1 && board[c - w] != wall && board[c - w * 2] != wall)
-                stack[++top] = c - w; // Adiciona a célula acima à pilha, se não for parede
+            if (y > 1 && sk->board[c - sk->w] != wall && sk->board[c - sk->w * 2] != wall)
+                stack[++top] = c - sk->w; // Adiciona a célula acima à pilha, se não for parede
 
             // Verificação para célula abaixo (y < h - 2 para evitar índice fora do limite inferior)
-            if (y < h - 2 && board[c + w] != wall && board[c + w * 2] != wall)
-                stack[++top] = c + w; // Adiciona a célula abaixo à pilha, se não for parede
+            if (y < sk->h - 2 && sk->board[c + sk->w] != wall && sk->board[c + sk->w * 2] != wall)
+                stack[++top] = c + sk->w; // Adiciona a célula abaixo à pilha, se não for parede
 
             // Verificação para célula à esquerda (x > 1 para evitar índice fora do limite esquerdo)
-            if (x > 1 && board[c - 1] != wall && board[c - 2] != wall)
+            if (x > 1 && sk->board[c - 1] != wall && sk->board[c - 2] != wall)
                 stack[++top] = c - 1; // Adiciona a célula à esquerda à pilha, se não for parede
 
             // Verificação para célula à direita (x < w - 2 para evitar índice fora do limite direito)
-            if (x < w - 2 && board[c + 1] != wall && board[c + 2] != wall)
+            if (x < sk->w - 2 && sk->board[c + 1] != wall && sk->board[c + 2] != wall)
                 stack[++top] = c + 1; // Adiciona a célula à direita à pilha, se não for parede
         }
     }
 }
+// Marca as células vivas a partir de todas as metas (precisa de board e goals)
+void mark_live()
+{
+    // Aloca memória para as células vivas (live) (w * h células de tamanho uint8_t)
+    sk->live = calloc(sk->w * sk->h, sizeof(uint8_t));
+    assert(sk->live); // Verifica se a alocação foi bem-sucedida
+
+// Parâmetros de execução paralela para marcar as células vivas
+#pragma omp parallel for copyin(sk)
+    for (int i = 0; i < sk->w * sk->h; i++)
+    {
+        if (sk->goals[i]) // Se for uma célula de objetivo
+        {
+            mark_live_iterative(i); // Marca as células vivas de forma iterativa
+        }
+    } // Espera todas as tarefas paralelas terminarem
+}
+
 // Função para fazer o parsing do tabuleiro a partir de uma string e define as posições iniciais do jogador e das caixas.
-state_t *parse_board(const char *s)
+sidx_t parse_board(const char *s)
 {
     // Aloca memória para o tabuleiro (w * h células de tamanho uint8_t)
-    board = calloc(w * h, sizeof(uint8_t));
-    assert(board); // Verifica se a alocação foi bem-sucedida
+    sk->board = calloc(sk->w * sk->h, sizeof(uint8_t));
+    assert(sk->board); // Verifica se a alocação foi bem-sucedida
 
     // Aloca memória para as células de objetivo (goals) (w * h células de tamanho uint8_t)
-    goals = calloc(w * h, sizeof(uint8_t));
-    assert(goals); // Verifica se a alocação foi bem-sucedida
-
-    // Aloca memória para as células vivas (live) (w * h células de tamanho uint8_t)
-    live = calloc(w * h, sizeof(uint8_t));
-    assert(live); // Verifica se a alocação foi bem-sucedida
+    sk->goals = calloc(sk->w * sk->h, sizeof(uint8_t));
+    assert(sk->goals); // Verifica se a alocação foi bem-sucedida
 
-    n_boxes = 0; // Inicializa a contagem de caixas
+    sk->n_boxes = 0; // Inicializa a contagem de caixas
 
     // Loop para analisar a string que representa o tabuleiro
     for (int i = 0; s[i]; i++)
@@ -160,42 +761,33 @@ state_t *parse_board(const char *s)
         switch (s[i]) // Ação baseada no caractere da string
         {
         case '#':            // Se o caractere for '#', marca a célula como parede
-            board[i] = wall; // Marca a célula como parede
+            sk->board[i] = wall; // Marca a célula como parede
             continue;        // Continua para o próximo caractere
         case '.':            // Se o caractere for '.', marca a célula como objetivo
         case '+':            // Se o caractere for '+', marca o jogador sobre um objetivo
-            goals[i] = 1;    // Marca a célula como objetivo
+            sk->goals[i] = 1;    // Marca a célula como objetivo
         case '@':            // Se o caractere for '@', marca o jogador
             continue;        // Continua para o próximo caractere
         case '*':            // Se o caractere for '*', marca a célula como caixa sobre um objetivo
-            goals[i] = 1;    // Marca a célula como objetivo
+            sk->goals[i] = 1;    // Marca a célula como objetivo
         case '$':            // Se o caractere for '$', marca a célula como caixa
-            n_boxes++;       // Incrementa o número de caixas
+            sk->n_boxes++;       // Incrementa o número de caixas
             continue;        // Continua para o próximo caractere
         default:             // Se o caractere for desconhecido, continua para o próximo
             continue;
         }
     }
 
-    // Alinha o tamanho do estado, considerando a quantidade de caixas
-    const int is = sizeof(int);                                                         // Tamanho de um int
-    state_size = (sizeof(state_t) + (1 + n_boxes) * sizeof(cidx_t) + is - 1) / is * is; // Ajuste de alinhamento de tamanho
+    // Alinha o tamanho do estado, considerando a quantidade de caixas (owner precisa de 8 bytes alinhados)
+    const size_t al = _Alignof(state_t);
+    sk->state_size = (offsetof(state_t, c) + (1 + sk->n_boxes) * sizeof(cidx_t) + al - 1) / al * al;
 
     // Cria o estado inicial usando a função newstate
-    state_t *state = newstate(NULL);
-
-// Parâmetros de execução paralela para marcar as células vivas
-#pragma omp parallel for
-    for (int i = 0; i < w * h; i++)
-    {
-        if (goals[i]) // Se for uma célula de objetivo
-        {
-            mark_live_iterative(i); // Marca as células vivas de forma iterativa
-        }
-    } // Espera todas as tarefas paralelas terminarem
+    const sidx_t start = newstate(0);
+    state_t *state = state_at(start);
 
     // Atribui as posições iniciais para o jogador e as caixas
-    for (int i = 0, j = 0; i < w * h; i++)
+    for (int i = 0, j = 0; i < sk->w * sk->h; i++)
     {
         if (s[i] == '$' || s[i] == '*')
             state->c[++j] = i; // Adiciona a posição da caixa
@@ -204,248 +796,4660 @@ state_t *parse_board(const char *s)
     }
 
     // Retorna o estado inicial
-    return state;
+    return start;
 }
 
 /*-----------  Tabela Hash -----------*/
 
-// Função para calcular o hash de um estado (hash K&R)
-void hash(state_t *s)
+/* Hash de Zobrist: cada célula tem uma chave aleatória para o jogador e outra para caixa,
+   e o hash do estado é o XOR das chaves ocupadas. Como o XOR não depende da ordem, o hash de
+   um sucessor sai do hash do pai em O(1) dentro de move_me, sem percorrer o vetor de caixas. */
+
+// Gerador splitmix64, usado só para sortear as chaves (semente fixa para execuções reproduzíveis)
+static hash_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Sorteia as chaves de Zobrist de todas as células do tabuleiro
+void init_zobrist()
 {
-    if (!s->h)
+    sk->zobrist_player = malloc(sk->w * sk->h * sizeof(hash_t));
+    sk->zobrist_box = malloc(sk->w * sk->h * sizeof(hash_t));
+    assert(sk->zobrist_player && sk->zobrist_box);
+
+    uint64_t seed = 0x536F6B6F62616E; // "Sokoban"
+    for (int i = 0; i < sk->w * sk->h; i++)
     {
-        register hash_t ha = 0;
-        cidx_t *p = s->c;
-        for (int i = 0; i <= n_boxes; i++) // Calcula o hash com base nas posições das células
-            ha = p[i] + 31 * ha;
-        s->h = ha; // Define o hash do estado
+        sk->zobrist_player[i] = splitmix64(&seed);
+        sk->zobrist_box[i] = splitmix64(&seed);
     }
 }
 
-// Funções de manipulação da tabela hash
-state_t **buckets;
-hash_t hash_size, fill_limit, filled;
+// Função para calcular o hash completo das posições c (estado inicial e estados relidos da arena)
+hash_t hash(const cidx_t *c)
+{
+    register hash_t ha = sk->zobrist_player[c[0]];
+    for (int i = 1; i <= sk->n_boxes; i++)
+        ha ^= sk->zobrist_box[c[i]];
+    return ha;
+}
+
+/* Tabela de estados visitados: endereçamento aberto com sondagem linear, segura para
+   várias threads sem travas. Cada posição é uma palavra de 64 bits com a impressão digital do
+   estado (32 bits altos do hash) e o índice do registro (32 bits baixos); como o índice nunca é
+   0, a palavra 0 marca posição vazia, e um único CAS reserva a posição e publica o estado.
 
-// Reorganiza e expande a tabela hash para suportar mais estados
-void extend_table()
+   O crescimento é incremental: reserve_table só aloca o vetor novo e guarda o antigo em old, que
+   a partir daí só é lido. Cada inserção migra um trecho de MIGRATE_CHUNK posições do antigo para o
+   novo, e as consultas e inserções olham os dois vetores enquanto a migração não termina. Um
+   estado do vetor antigo é achado lá por quem tenta inseri-lo de novo, então nunca é inserido em
+   dobro no novo; a migração só precisa da primeira posição vazia. O vetor antigo é liberado na
+   próxima chamada de reserve_table depois de migrado (fora da expansão paralela, quando ninguém
+   mais o lê), e só é migrado de uma vez se a tabela precisar crescer de novo antes disso. */
+#define MIGRATE_CHUNK 64 // posições do vetor antigo migradas por inserção
+
+// Impressão digital guardada na posição da tabela junto com o índice do estado
+static inline slot_t fingerprint(hash_t h)
 {
-    int old_size = hash_size;
-    if (!old_size)
-    {
-        hash_size = 1024;
-        filled = 0;
-        fill_limit = hash_size * 3 / 4;
-    }
-    else
-    {
-        hash_size *= 2;
-        fill_limit *= 2;
-    }
+    return h >> 32 << 32;
+}
 
-    state_t **new_buckets = calloc(hash_size, sizeof(state_t *));
-    assert(new_buckets);
+// Posição inicial da sondagem num vetor de 2^bits posições (hash de Fibonacci, usa os bits altos do produto)
+static inline size_t slot_of(int bits, hash_t h)
+{
+    return (size_t)((h * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
 
-    const hash_t bits = hash_size - 1;
+// Migra o próximo trecho do vetor antigo para o novo; retorna false se não havia trecho a migrar
+static bool migrate_chunk(table_t *t)
+{
+    if (__atomic_load_n(&t->next_chunk, __ATOMIC_RELAXED) >= t->old_size)
+        return false;
+    const size_t start = __atomic_fetch_add(&t->next_chunk, MIGRATE_CHUNK, __ATOMIC_RELAXED);
+    if (start >= t->old_size)
+        return false;
+    const size_t end = start + MIGRATE_CHUNK < t->old_size ? start + MIGRATE_CHUNK : t->old_size;
+    const size_t mask = t->size - 1;
 
-#pragma omp parallel for
-    for (int i = 0; i < old_size; i++)
+    // A posição depende do hash inteiro, que é refeito a partir do registro
+    for (size_t i = start; i < end; i++)
     {
-        state_t *head = buckets[i];
-        while (head)
+        const slot_t v = t->old[i];
+        if (!v)
+            continue;
+        for (size_t j = slot_of(t->bits, hash(state_at((sidx_t)v)->c));; j = (j + 1) & mask)
         {
-            state_t *next = head->next;
-            const int j = head->h & bits;
-#pragma omp atomic capture
-            {
-                head->next = new_buckets[j];
-                new_buckets[j] = head;
-            }
-            head = next;
+            slot_t empty = 0;
+            if (__atomic_compare_exchange_n(&t->slots[j], &empty, v, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                break;
         }
     }
-
-    free(buckets);
-    buckets = new_buckets;
+    __atomic_fetch_add(&t->moved, end - start, __ATOMIC_RELAXED);
+    return true;
 }
 
-// Função para procurar um estado na tabela de hash, verifica se um estado já foi explorado usando a tabela hash
-state_t *lookup(state_t *s)
+// Garante espaço para mais `extra` estados sem passar de 3/4 de ocupação, trocando o vetor se necessário
+// Só pode ser chamada fora da expansão paralela (na barreira entre camadas)
+void reserve_table(table_t *t, size_t extra)
 {
-    hash(s); // Calcula o hash do estado
-    state_t *f = buckets[s->h & (hash_size - 1)];
-
-    // Nesse caso, para paralelizar, necessitaria criar uma estrutura a mais para poder realizar o processo em paralelo, além de funções de leitura
-    // que no caso para esse teste pequeno, não seria muito eficiente, ou a melhoria de performance seria minima, não compensando a memória extra necessária
-    for (; f; f = f->next)
+    if (t->old && t->moved == t->old_size) // Migração terminada: ninguém mais lê o vetor antigo
     {
-        if (                                                     //(f->h == s->h) &&
-            !memcmp(s->c, f->c, sizeof(cidx_t) * (1 + n_boxes))) // Compara os estados
-            break;
+        table_release(t->old, t->old_size * sizeof(slot_t));
+        t->old = NULL;
     }
 
-    return f;
-}
+    size_t new_size = t->size ? t->size : 1024;
+    while ((t->filled + extra) > new_size / 4 * 3)
+        new_size *= 2;
+    if (new_size == t->size)
+        return;
 
-// Função para adicionar um estado à tabela de hash
-bool add_to_table(state_t *s)
-{
-    if (lookup(s)) // Se o estado já existe na tabela, retorna falso
+    if (t->old) // Cresceu de novo antes de terminar a migração anterior: termina agora
     {
-        unnewstate(s);
-        return false;
+#pragma omp parallel copyin(sk)
+        while (migrate_chunk(t))
+            ;
+        table_release(t->old, t->old_size * sizeof(slot_t));
     }
 
-    if (filled++ >= fill_limit) // Se a tabela estiver cheia, expande a capacidade da tabela
-        extend_table();
-
-    hash_t i = s->h & (hash_size - 1); // Calcula o índice da tabela
+    t->old = t->size ? t->slots : NULL;
+    t->old_size = t->size;
+    t->old_bits = t->bits;
+    t->next_chunk = t->moved = 0;
 
-    s->next = buckets[i];
-    buckets[i] = s; // Adiciona o estado à tabela
-    return true;
+    t->slots = table_alloc(new_size * sizeof(slot_t));
+    assert(t->slots);
+    t->size = new_size;
+    for (t->bits = 0; ((size_t)1 << t->bits) < new_size; t->bits++)
+        ;
 }
 
-// Função para verificar se o jogo foi ganho (todas as caixas estão nas metas, ou seja, se o jogador ganhou)
-bool success(const state_t *s)
+// Libera os vetores da tabela e a deixa vazia
+void free_table(table_t *t)
 {
-    for (int i = 1; i <= n_boxes; i++)
-        if (!goals[s->c[i]]) // Verifica se todas as caixas estão nas metas
-            return false;
-    return true;
+    table_release(t->slots, t->size * sizeof(slot_t));
+    table_release(t->old, t->old_size * sizeof(slot_t));
+    memset(t, 0, sizeof(*t));
 }
 
-// Função para mover o jogador e as caixas
-// Move o jogador e, se necessário, empurra uma caixa. Gera um novo estado correspondente ao movimento
-state_t *move_me(state_t *s, const int dy, const int dx)
+// Procura as posições c (com hash h) num vetor de 2^bits posições; retorna o índice do estado ou 0
+static sidx_t probe(const slot_t *slots, int bits, const cidx_t *c, hash_t h)
 {
-    const int y = s->c[0] / w;
-    const int x = s->c[0] % w;
-    const int y1 = y + dy;
-    const int x1 = x + dx;
-    const int c1 = y1 * w + x1;
-
-    if (y1 < 0 || y1 > h || x1 < 0 || x1 > w ||
-        board[c1] == wall) // Verifica se o movimento é válido
-        return NULL;
+    const slot_t fp = fingerprint(h);
+    const size_t mask = ((size_t)1 << bits) - 1, first = slot_of(bits, h);
 
-    int at_box = 0;
-    for (int i = 1; i <= n_boxes; i++)
+    for (size_t i = first;; i = (i + 1) & mask)
     {
-        if (s->c[i] == c1)
+        const slot_t cur = __atomic_load_n(&slots[i], __ATOMIC_ACQUIRE);
+        if (!cur)
         {
-            at_box = i; // Verifica se o jogador está em uma caixa
-            break;
+            TELE(probes, ((i - first) & mask) + 1);
+            return 0;
         }
-    }
+        if (fingerprint(cur) != fp) // Impressões digitais diferentes dispensam o memcmp
+            continue;
 
-    int c2;
-    if (at_box) // Se houver uma caixa, move a caixa
-    {
-        c2 = c1 + dy * w + dx;
-        if (board[c2] == wall || !live[c2])
-            return NULL;
-        for (int i = 1; i <= n_boxes; i++)
-            if (s->c[i] == c2) // Verifica se a nova posição da caixa está ocupada
-                return NULL;
+        const sidx_t f = (sidx_t)cur;
+        if (!memcmp(c, state_at(f)->c, sizeof(cidx_t) * (1 + sk->n_boxes))) // Compara os estados
+        {
+            TELE(probes, ((i - first) & mask) + 1);
+            return f;
+        }
     }
+}
 
-    state_t *n = newstate(s);                             // Cria um novo estado
-    memcpy(n->c + 1, s->c + 1, sizeof(cidx_t) * n_boxes); // Copia a posição das caixas
+// Função para procurar um estado na tabela de hash, verifica se um estado já foi explorado usando a tabela hash
+// Recebe as posições c e o hash delas (move_me ou hash()); retorna o índice do estado ou 0
+sidx_t lookup(const table_t *t, const cidx_t *c, hash_t h)
+{
+    TELE(accesses, 1);
+    const sidx_t f = probe(t->slots, t->bits, c, h);
+    return f || !t->old ? f : probe(t->old, t->old_bits, c, h);
+}
 
-    cidx_t *p = n->c;
-    p[0] = c1; // Atualiza a posição do jogador
+// Insere o estado s (com hash h) se ele ainda não estiver na tabela
+// Retorna true se esta chamada fez a inserção e false se o estado já existia (inserido por esta ou
+// outra thread); nesse caso *existing recebe o estado que está na tabela
+bool insert_if_absent(table_t *t, sidx_t s, hash_t h, sidx_t *existing)
+{
+    const cidx_t *c = state_at(s)->c;
+    TELE(accesses, 1);
 
-    if (at_box)
-        p[at_box] = c2; // Atualiza a posição da caixa
+    // Durante a migração, o estado pode estar no vetor antigo (que não muda mais)
+    if (t->old)
+    {
+        migrate_chunk(t);
+        const sidx_t f = probe(t->old, t->old_bits, c, h);
+        if (f)
+        {
+            *existing = f;
+            return false;
+        }
+    }
 
-    // Ordena as posições das caixas (bubble sort)
-    for (int i = n_boxes; --i;)
+    const slot_t fp = fingerprint(h);
+    const size_t mask = t->size - 1, first = slot_of(t->bits, h);
+    for (size_t i = first;; i = (i + 1) & mask)
     {
-        cidx_t t = 0;
-        for (int j = 1; j < i; j++)
+        slot_t cur = __atomic_load_n(&t->slots[i], __ATOMIC_ACQUIRE);
+        if (!cur)
         {
-            if (p[j] > p[j + 1])
-                t = p[j], p[j] = p[j + 1], p[j + 1] = t;
+            if (__atomic_compare_exchange_n(&t->slots[i], &cur, fp | s, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                TELE(probes, ((i - first) & mask) + 1);
+                return true;
+            }
+            // Outra thread ocupou a posição primeiro: cur agora tem o estado dela
+        }
+        if (fingerprint(cur) != fp)
+            continue;
+
+        const sidx_t f = (sidx_t)cur;
+        if (!memcmp(c, state_at(f)->c, sizeof(cidx_t) * (1 + sk->n_boxes)))
+        {
+            TELE(probes, ((i - first) & mask) + 1);
+            *existing = f;
+            return false;
         }
-        if (!t)
-            break;
     }
+}
 
-    return n;
+// Função para verificar se o jogo foi ganho (todas as caixas estão nas metas, ou seja, se o jogador ganhou)
+bool success(const cidx_t *c)
+{
+    for (int i = 1; i <= sk->n_boxes; i++)
+        if (!sk->goals[c[i]]) // Verifica se todas as caixas estão nas metas
+            return false;
+    return true;
 }
 
-// Variáveis de controle de níveis e soluções
-state_t *next_level, *done;
+/*----------- Detecção de deadlocks -----------*/
+
+/* O live[] só descarta casas de onde uma caixa sozinha nunca chega a uma meta. Os testes abaixo
+   olham a posição das outras caixas depois de cada empurrão: caixas congeladas fora de meta,
+   blocos 2x2 sem saída e a falta de um emparelhamento caixa-meta. Nenhum descarta estado que
+   leve à solução, então o caminho encontrado é o mesmo com ou sem eles. */
 
-// Função para adicionar um movimento à fila
-// Adiciona um novo estado à fila de exploração, verificando se o jogo foi resolvido
-bool queue_move(state_t *s)
+#define INF_DIST 0xFFFF // meta inalcançável a partir da célula
+#define INF_COST 1000000 // custo de heurística que indica estado sem saída
+
+// Calcula as tabelas de distância em empurrões de cada célula até cada meta (uma meta por iteração)
+void init_goal_dist()
 {
-    if (!s || !add_to_table(s)) // Se o estado não for válido, retorna falso
-        return false;
+    sk->n_goals = 0;
+    for (int i = 0; i < sk->w * sk->h; i++)
+        sk->n_goals += sk->goals[i];
+    sk->goal_cells = malloc(sk->n_goals * sizeof(int));
+    sk->goal_dist = malloc((size_t)sk->n_goals * sk->w * sk->h * sizeof(uint16_t));
+    assert(sk->goal_cells && sk->goal_dist);
+    for (int i = 0, j = 0; i < sk->w * sk->h; i++)
+        if (sk->goals[i])
+            sk->goal_cells[j++] = i;
 
-    if (success(s)) // Se o jogo foi ganho, define o estado final
+#pragma omp parallel for schedule(dynamic, 1) copyin(sk)
+    for (int g = 0; g < sk->n_goals; g++)
     {
-        done = s;
-        return true;
-    }
+        uint16_t *dist = sk->goal_dist + (size_t)g * sk->w * sk->h;
+        cidx_t *queue = malloc(sk->w * sk->h * sizeof(cidx_t));
+        assert(queue);
+        for (int i = 0; i < sk->w * sk->h; i++)
+            dist[i] = INF_DIST;
 
-    s->qnext = next_level;
-    next_level = s; // Adiciona o estado à fila de próximos movimentos
-    return false;
+        // BFS reversa: a caixa em y chega a x = y + offsets[d] com o jogador em y - offsets[d]
+        int head = 0, tail = 0;
+        dist[sk->goal_cells[g]] = 0;
+        queue[tail++] = sk->goal_cells[g];
+        while (head < tail)
+        {
+            const int x = queue[head++];
+            for (int d = 0; d < 4; d++)
+            {
+                const int y = x - sk->offsets[d], pl = y - sk->offsets[d];
+                if (pl < 0 || pl >= sk->w * sk->h || sk->board[y] == wall || sk->board[pl] == wall || dist[y] != INF_DIST)
+                    continue;
+                dist[y] = dist[x] + 1;
+                queue[tail++] = y;
+            }
+        }
+        free(queue);
+    }
 }
 
-// Função para realizar um movimento em todas as direções
-bool do_move(state_t *s)
+// Aloca os vetores do emparelhamento e do algoritmo húngaro de cada thread, que dependem de n_goals
+void init_matching()
 {
-    return queue_move(move_me(s, 0, 1)) ||  // Move para a direita
-           queue_move(move_me(s, 0, -1)) || // Move para a esquerda
-           queue_move(move_me(s, -1, 0)) || // Move para cima
-           queue_move(move_me(s, 1, 0));    // Move para baixo
+    for (int t = 0; t < sk->n_workers; t++)
+    {
+        sk->workers[t].match_box = malloc(sk->n_goals * sizeof(int));
+        sk->workers[t].match_seen = malloc(sk->n_goals * sizeof(uint8_t));
+        sk->workers[t].hung = malloc((sk->n_boxes + 1 + 4 * (sk->n_goals + 1)) * sizeof(int));
+        sk->workers[t].hung_used = malloc((sk->n_goals + 1) * sizeof(bool));
+        assert(sk->workers[t].match_box && sk->workers[t].match_seen && sk->workers[t].hung && sk->workers[t].hung_used);
+    }
 }
 
-// Função para exibir os movimentos feitos
-void show_moves(const state_t *s, int nextPos)
+// Verifica se a caixa em c (occ marca as caixas) está congelada: presa nos dois eixos por paredes,
+// por casas mortas dos dois lados ou por caixas também congeladas. As caixas em análise ficam em
+// mark e contam como parede, o que evita ciclos. Se estiver congelada, *off diz se alguma caixa
+// da qual o congelamento depende (ela inclusive) está fora de uma meta.
+static bool frozen(int c, const uint8_t *occ, uint8_t *mark, bool *off)
 {
-
-    if (s->prev)                      // Se houver um estado anterior, chama a função recursivamente para exibir os movimentos anteriores
-        show_moves(s->prev, s->c[0]); // Exibe os movimentos recursivamente
-    if (nextPos == -1)                // Calcula as coordenadas do estado atual (cx, cy) e do próximo movimento (nx, ny)
+    bool stuck = true, sub_off = !sk->goals[c];
+    mark[c] = 1;
+    for (int axis = 0; axis < 4 && stuck; axis += 2) // eixos horizontal (0, 1) e vertical (2, 3)
     {
-        printf("\n");
-        return;
+        const int a = c + sk->offsets[axis], b = c + sk->offsets[axis + 1];
+        bool blocked = sk->board[a] == wall || sk->board[b] == wall || (!sk->live[a] && !sk->live[b]);
+        for (int k = 0; k < 2 && !blocked; k++)
+        {
+            const int n = k ? b : a;
+            bool n_off = false;
+            if (occ[n] && (mark[n] || frozen(n, occ, mark, &n_off)))
+                blocked = true, sub_off |= n_off;
+        }
+        stuck = blocked;
     }
+    mark[c] = 0;
+    if (stuck)
+        *off = sub_off;
+    return stuck;
+}
 
-    // Calcula as coordenadas do estado atual (cx, cy) e do próximo movimento (nx, ny)
-    int cx = s->c[0] % w;
-    int cy = s->c[0] / w;
-    int nx = nextPos % w;
-    int ny = nextPos / w;
-    int box = 0;
-    for (int i = 1; !box && i <= n_boxes; i++)
-        box = s->c[i] == nextPos; // Verifica se há uma caixa no próximo movimento
-    if (cx < nx)
-        printf(box ? "R" : "r"); // Move para a direita
-    else if (cx > nx)
-        printf(box ? "L" : "l"); // Move para a esquerda
-    else if (cy < ny)
-        printf(box ? "D" : "d"); // Move para baixo
-    else if (cy > ny)
-        printf(box ? "U" : "u"); // Move para cima
-    else if (1)
+// Verifica se a caixa em c faz parte de um bloco 2x2 de caixas e paredes com alguma caixa fora de meta
+static bool square_block(int c, const uint8_t *occ)
+{
+    static const int dx[4] = {0, -1, 0, -1}, dy[4] = {0, 0, -1, -1};
+    for (int q = 0; q < 4; q++)
     {
-        printf("Movimento inválido\n");
-        exit(1);
+        const int base = c + dy[q] * sk->w + dx[q]; // canto superior esquerdo do bloco
+        const int cells[4] = {base, base + 1, base + sk->w, base + sk->w + 1};
+        bool closed = true, off = false;
+        for (int k = 0; k < 4 && closed; k++)
+        {
+            if (occ[cells[k]])
+                off |= !sk->goals[cells[k]];
+            else if (sk->board[cells[k]] != wall)
+                closed = false;
+        }
+        if (closed && off)
+            return true;
     }
+    return false;
 }
 
-int main()
+// Procura um caminho de aumento para a caixa b no emparelhamento caixa-meta (algoritmo de Kuhn)
+static bool augment(const cidx_t *c, int b, worker_t *wk)
 {
-
+    for (int g = 0; g < sk->n_goals; g++)
+    {
+        if (wk->match_seen[g] || sk->goal_dist[(size_t)g * sk->w * sk->h + c[b]] == INF_DIST)
+            continue;
+        wk->match_seen[g] = 1;
+        if (!wk->match_box[g] || augment(c, wk->match_box[g], wk))
+        {
+            wk->match_box[g] = b;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Verifica se cada caixa de c pode ser levada a uma meta distinta (ignorando as outras caixas)
+static bool matchable(const cidx_t *c, worker_t *wk)
+{
+    if (sk->n_goals < sk->n_boxes)
+        return false;
+    memset(wk->match_box, 0, sk->n_goals * sizeof(int));
+    for (int b = 1; b <= sk->n_boxes; b++)
+    {
+        memset(wk->match_seen, 0, sk->n_goals);
+        if (!augment(c, b, wk))
+            return false;
+    }
+    return true;
+}
+
+// Verifica se a caixa, ao ir de `from` para `to`, deixou de alcançar alguma meta
+// Como `to` é alcançável a partir de `from`, as metas de `to` são um subconjunto das de `from`; se
+// nenhuma se perdeu, o emparelhamento do pai continua valendo e não precisa ser refeito
+static bool lost_goal(int from, int to)
+{
+    for (int g = 0; g < sk->n_goals; g++)
+    {
+        const uint16_t *dist = sk->goal_dist + (size_t)g * sk->w * sk->h;
+        if (dist[from] != INF_DIST && dist[to] == INF_DIST)
+            return true;
+    }
+    return false;
+}
+
+// Aplica os testes ativos ao estado c, em que a caixa acabou de ser empurrada de `from` para `to`
+// wk->occ deve marcar as caixas de c. Conta a poda no primeiro teste que descartar o estado.
+bool deadlocked(const cidx_t *c, int from, int to, worker_t *wk)
+{
+    bool off = false;
+    int k = -1;
+    if ((sk->deadlock_checks & 1 << DL_SQUARE) && square_block(to, wk->occ))
+        k = DL_SQUARE;
+    else if ((sk->deadlock_checks & 1 << DL_FREEZE) && frozen(to, wk->occ, wk->mark, &off) && off)
+        k = DL_FREEZE;
+    else if ((sk->deadlock_checks & 1 << DL_MATCH) && lost_goal(from, to) && !matchable(c, wk))
+        k = DL_MATCH;
+    if (k < 0)
+        return false;
+    wk->pruned[k]++;
+    return true;
+}
+
+/*----------- Fronteira da busca -----------*/
+
+/* Cada camada da busca fica em vetores contíguos e alinhados à linha de cache: as posições de
+   cada estado em sequência (1 + n_boxes por linha), o hash, o registro na arena (usado para montar
+   o caminho) e o índice do pai na camada anterior. A expansão lê esses vetores em ordem, sem
+   seguir ponteiros, e cada thread pega faixas fixas de CHUNK estados. */
+#define CHUNK 256 // estados por faixa da camada distribuída às threads
+
+// Linha de posições do i-ésimo estado da camada
+static inline cidx_t *row(const frontier_t *f, size_t i)
+{
+    return f->cells + i * (1 + sk->n_boxes);
+}
+
+// Aloca uma camada com espaço para n estados
+void alloc_frontier(frontier_t *f, size_t n)
+{
+    const size_t row_bytes = (1 + sk->n_boxes) * sizeof(cidx_t);
+    f->cells = alloc_aligned(n * row_bytes);
+    f->hashes = alloc_aligned(n * sizeof(hash_t));
+    f->refs = alloc_aligned(n * sizeof(sidx_t));
+    f->parent = alloc_aligned(n * sizeof(uint32_t));
+    assert(f->cells && f->hashes && f->refs && f->parent);
+    f->n = n;
+}
+
+// Libera os vetores de uma camada e a deixa vazia
+void free_frontier(frontier_t *f)
+{
+    free(f->cells);
+    free(f->hashes);
+    free(f->refs);
+    free(f->parent);
+    memset(f, 0, sizeof(*f));
+}
+
+/* Chave de geração de um sucessor: camada (16 bits), índice do pai na camada (36 bits) e número
+   do sucessor dentro do pai (12 bits). A ordem das chaves é a ordem FIFO de uma BFS sequencial,
+   então o dono de um estado gerado por várias threads na mesma camada é o de menor chave. */
+#define KEY_SUCC_BITS 12
+#define KEY_DEPTH_SHIFT 48
+
+static inline uint64_t make_key(uint64_t depth, uint64_t parent, uint64_t succ)
+{
+    return depth << KEY_DEPTH_SHIFT | parent << KEY_SUCC_BITS | succ;
+}
+
+static inline size_t key_parent(uint64_t key)
+{
+    return (key >> KEY_SUCC_BITS) & ((1ull << (KEY_DEPTH_SHIFT - KEY_SUCC_BITS)) - 1);
+}
+
+/* Geração de sucessores: os vizinhos de cada célula são tabelados uma vez por nível e quem expande
+   um estado marca as caixas dele em wk->occ, então um passo não procura a caixa nem o destino no
+   vetor de caixas. O sucessor é montado no rascunho da thread (wk->succ) e só vira registro na
+   arena depois de passar pela tabela de visitados (ver queue_move). */
+
+// Tabela os vizinhos de cada célula (precisa de board e offsets)
+void init_neighbors()
+{
+    sk->neighbor = malloc((size_t)sk->w * sk->h * 4 * sizeof(int));
+    assert(sk->neighbor);
+    for (int c = 0; c < sk->w * sk->h; c++)
+        for (int d = 0; d < 4; d++)
+        {
+            const int n = c + sk->offsets[d];
+            const bool wraps = (d == 0 && c % sk->w == sk->w - 1) || (d == 1 && c % sk->w == 0);
+            sk->neighbor[c * 4 + d] = n < 0 || n >= sk->w * sk->h || wraps || sk->board[n] == wall ? -1 : n;
+        }
+}
+
+// Função para mover o jogador e as caixas
+// Move o jogador do estado c (com hash hs) na direção d (direita, esquerda, cima, baixo) e, se
+// necessário, empurra uma caixa. As posições do sucessor vão para p, com as caixas em ordem, e o
+// hash para *nh. wk->occ deve marcar as caixas de c
+// Retorna false se o movimento for inválido ou se o empurrão cair num deadlock (ver deadlocked)
+bool move_me(const cidx_t *c, hash_t hs, int d, cidx_t *p, hash_t *nh, worker_t *wk)
+{
+    const int c1 = sk->neighbor[c[0] * 4 + d];
+    if (c1 < 0) // Verifica se o movimento é válido
+        return false;
+
+    // Atualiza o hash de Zobrist a partir do pai: troca a chave do jogador e, se empurrou, a da caixa
+    *nh = hs ^ sk->zobrist_player[c[0]] ^ sk->zobrist_player[c1];
+    memcpy(p + 1, c + 1, sizeof(cidx_t) * sk->n_boxes); // Copia a posição das caixas
+    p[0] = c1;                                      // Atualiza a posição do jogador
+    if (!wk->occ[c1])                               // Só andou
+        return true;
+
+    const int c2 = sk->neighbor[c1 * 4 + d]; // Destino da caixa empurrada
+    if (c2 < 0 || !sk->live[c2])
+    {
+        TELE(live_pruned, 1);
+        return false;
+    }
+    if (wk->occ[c2]) // Verifica se a nova posição da caixa está ocupada
+        return false;
+    *nh ^= sk->zobrist_box[c1] ^ sk->zobrist_box[c2];
+
+    // Desloca a caixa até a sua posição no vetor ordenado (um único deslocamento por inserção)
+    int k = 1;
+    while (p[k] != c1)
+        k++;
+    if (c2 > c1)
+        for (; k < sk->n_boxes && p[k + 1] < c2; k++)
+            p[k] = p[k + 1];
+    else
+        for (; k > 1 && p[k - 1] > c2; k--)
+            p[k] = p[k - 1];
+    p[k] = c2;
+
+    if (sk->deadlock_checks)
+    {
+        wk->occ[c1] = 0, wk->occ[c2] = 1; // occ passa a refletir as caixas do sucessor
+        const bool dead = deadlocked(p, c1, c2, wk);
+        wk->occ[c2] = 0, wk->occ[c1] = 1;
+        if (dead)
+            return false;
+    }
+    return true;
+}
+
+bool lean_seen(const cidx_t *p, hash_t h);
+
+#ifdef USE_MPI
+void mpi_queue(search_t *se, const cidx_t *p, hash_t h, uint64_t key, worker_t *wk);
+#endif
+
+// Função para adicionar um movimento à lista de sucessores da thread
+// Procura as posições p (com hash h) na tabela do lado e só cria o registro se o estado for novo; se
+// ele já existia e é da camada que está sendo gerada, disputa a posse dele pela menor chave.
+// Retorna true se o sucessor resolve o jogo (ou encontra o outro lado).
+bool queue_move(search_t *se, const cidx_t *p, hash_t h, uint64_t key, worker_t *wk)
+{
+    TELE(generated, 1);
+#ifdef USE_MPI
+    if (sk->distributed) // O dono do sucessor pode ser outro processo: ele vai para o buffer de envio
+    {
+        mpi_queue(se, p, h, key, wk);
+        return false;
+    }
+#endif
+
+    sidx_t s = lookup(&se->table, p, h);
+    bool fresh = false;
+    if (!s && sk->lean && lean_seen(p, h)) // Visitado numa das camadas anteriores ainda guardadas
+    {
+        TELE(duplicates, 1);
+        return false;
+    }
+    if (!s)
+    {
+        // O pai do registro é definido quando ele é copiado para a próxima camada (expand_level)
+        s = newstate(0);
+        state_t *st = state_at(s);
+        memcpy(st->c, p, (1 + sk->n_boxes) * sizeof(cidx_t));
+        st->owner = key; // Precisa estar pronto antes de o estado ser publicado na tabela
+        sidx_t f;
+        fresh = insert_if_absent(&se->table, s, h, &f);
+        if (!fresh) // Outra thread inseriu o mesmo estado entre a consulta e a inserção
+        {
+            unnewstate(s);
+            s = f;
+        }
+    }
+    if (!fresh)
+    {
+        TELE(duplicates, 1);
+        uint64_t *owner = &state_at(s)->owner;
+        uint64_t cur = __atomic_load_n(owner, __ATOMIC_RELAXED);
+        if ((cur >> KEY_DEPTH_SHIFT) != (key >> KEY_DEPTH_SHIFT))
+            return false; // Já visitado numa camada anterior
+
+        while (key < cur && !__atomic_compare_exchange_n(owner, &cur, key, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+    }
+
+    if (wk->n_cand == wk->cap_cand)
+    {
+        wk->cap_cand = wk->cap_cand ? wk->cap_cand * 2 : 1024;
+        wk->cand = realloc(wk->cand, wk->cap_cand * sizeof(cand_t));
+        assert(wk->cand);
+    }
+    wk->cand[wk->n_cand++] = (cand_t){key, h, s};
+
+    // O outro lado só é lido enquanto este expande, então a consulta não precisa de sincronização
+    const bool target = se->other ? lookup(&se->other->table, p, h) != 0
+                        : sk->lean_target ? !memcmp(p, sk->lean_target, (1 + sk->n_boxes) * sizeof(cidx_t))
+                        : success(p);
+    if (target) // Se o jogo foi ganho, registra a menor chave que chegou ao final
+    {
+        uint64_t cur = __atomic_load_n(&sk->best_key, __ATOMIC_RELAXED);
+        while (key < cur && !__atomic_compare_exchange_n(&sk->best_key, &cur, key, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+        return true;
+    }
+    return false;
+}
+
+// Função para realizar um movimento em todas as direções a partir do i-ésimo estado da camada
+bool do_move(search_t *se, size_t i, worker_t *wk)
+{
+    const cidx_t *c = row(&se->level, i);
+    const hash_t hs = se->level.hashes[i];
+    bool found = false;
+    hash_t nh;
+    for (int k = 1; k <= sk->n_boxes; k++)
+        wk->occ[c[k]] = 1;
+    for (int d = 0; d < 4 && !found; d++) // Direita, esquerda, cima e baixo
+        if (move_me(c, hs, d, wk->succ, &nh, wk))
+            found = queue_move(se, wk->succ, nh, make_key(se->depth + 1, i, d), wk);
+    for (int k = 1; k <= sk->n_boxes; k++)
+        wk->occ[c[k]] = 0;
+    return found;
+}
+
+/*----------- Modo de empurrões (estado normalizado pela região do jogador) -----------*/
+
+/* Neste modo um estado é o conjunto de caixas mais uma célula canônica do jogador: a de menor
+   índice entre as que ele alcança sem empurrar nada. Estados que só diferem pela posição do
+   jogador dentro da mesma região viram um só, e os sucessores são apenas empurrões. O caminho
+   a pé entre os empurrões é refeito no final por show_pushes. A solução é ótima em número de
+   empurrões (não necessariamente em número de passos). */
+
+// Flood fill do jogador a partir de start, sem atravessar paredes nem caixas (occ)
+// Marca as células alcançadas em seen e retorna a de menor índice (a posição canônica)
+int flood(int start, const uint8_t *occ, uint8_t *seen, cidx_t *queue)
+{
+    memset(seen, 0, sk->w * sk->h);
+    int head = 0, tail = 0, min = start;
+    queue[tail++] = start;
+    seen[start] = 1;
+
+    while (head < tail)
+    {
+        const int c = queue[head++];
+        if (c < min)
+            min = c;
+        for (int d = 0; d < 4; d++)
+        {
+            const int n = c + sk->offsets[d];
+            if (n < 0 || n >= sk->w * sk->h || sk->board[n] == wall || occ[n] || seen[n])
+                continue;
+            seen[n] = 1;
+            queue[tail++] = n;
+        }
+    }
+    return min;
+}
+
+// Coloca o jogador do estado na sua posição canônica
+void normalize(state_t *s, worker_t *wk)
+{
+    for (int i = 1; i <= sk->n_boxes; i++)
+        wk->occ[s->c[i]] = 1;
+    s->c[0] = flood(s->c[0], wk->occ, wk->seen, wk->queue);
+    for (int i = 1; i <= sk->n_boxes; i++)
+        wk->occ[s->c[i]] = 0;
+}
+
+// Gera em p as posições do estado em que a caixa em `from` do estado c (hash hs) foi para `to` e o
+// jogador para `player` (empurrão: atrás da caixa; puxada: a célula para onde o jogador recuou), e o
+// hash em *nh. occ deve refletir as caixas do pai; a posição do jogador é normalizada
+// Retorna false se o empurrão (push) cair num deadlock
+bool move_box(const cidx_t *c, hash_t hs, int from, int to, int player, bool push, cidx_t *p, hash_t *nh, worker_t *wk)
+{
+    // Copia as caixas trocando `from` por `to`, mantendo o vetor ordenado
+    int j = 1;
+    bool placed = false;
+    for (int k = 1; k <= sk->n_boxes; k++)
+    {
+        const cidx_t b = c[k];
+        if (b == from)
+            continue;
+        if (!placed && to < b)
+            p[j++] = to, placed = true;
+        p[j++] = b;
+    }
+    if (!placed) // `to` é maior que todas as outras caixas
+        p[j] = to;
+
+    wk->occ[from] = 0;
+    wk->occ[to] = 1;
+    // Só empurrões passam pelos testes de deadlock; as puxadas da busca reversa não
+    const bool dead = push && sk->deadlock_checks && deadlocked(p, from, to, wk);
+    if (!dead)
+        p[0] = flood(player, wk->occ, wk->seen2, wk->queue);
+    wk->occ[to] = 0;
+    wk->occ[from] = 1;
+    if (dead)
+        return false;
+
+    *nh = hs ^ sk->zobrist_player[c[0]] ^ sk->zobrist_player[p[0]] ^ sk->zobrist_box[from] ^ sk->zobrist_box[to];
+    return true;
+}
+
+/*----------- Macros: túneis e salas de metas -----------*/
+
+/* Com -u (que implica -p), um empurrão pode levar a caixa várias casas numa só transição, o que
+   corta camadas da busca e ramos inúteis:
+   - Túnel: se a caixa e o jogador atrás dela estão num corredor de largura 1 (paredes dos dois
+     lados, ver corridor), a caixa segue empurrada até sair do corredor, parar numa meta ou numa
+     porta de sala, ou ser barrada por parede, caixa ou casa morta.
+   - Sala de metas: região com metas ligada ao resto do nível por uma única casa (a porta). Na
+     análise, as metas de cada sala ganham uma ordem de preenchimento (da mais funda para a mais
+     rasa, sem que uma meta ocupada impeça as seguintes), com o caminho de cada uma a partir da
+     porta. Uma caixa empurrada de fora para a porta vai direto para a próxima meta da ordem,
+     desde que a sala só tenha as caixas das metas anteriores; senão o empurrão é o comum.
+   Como em outros resolvedores com essas macros, elas podem perder soluções que estacionam uma
+   caixa dentro de um túnel ou num canto da sala. Na busca em largura uma macro conta como uma
+   camada, então o caminho deixa de ser o de menos empurrões; no A* ela custa os empurrões que
+   faz. show_path refaz os empurrões de cada macro com uma busca só da caixa que andou. */
+#define MAX_ROOM_CELLS 128 // salas maiores não ganham macro (a ordem de preenchimento fica cara)
+
+// Busca em largura dos empurrões de uma só caixa, da caixa em `from` com o jogador em `player`.
+// Os nós são célula * 4 + d: a caixa na célula e o jogador atrás dela, depois de empurrar na
+// direção d. blk marca as células em que nem a caixa nem o jogador podem entrar, além das paredes;
+// a caixa só vai para casas vivas. Preenche dist[nó] (empurrões, -1 se inalcançável) e prev[nó]
+// (nó anterior, -1 no primeiro empurrão)
+void box_bfs(int from, int player, uint8_t *blk, int *dist, int *prev)
+{
+    uint8_t *seen = malloc(sk->w * sk->h);
+    cidx_t *fill = malloc(sk->w * sk->h * sizeof(cidx_t));
+    int *queue = malloc((size_t)sk->w * sk->h * 4 * sizeof(int));
+    assert(seen && fill && queue);
+    for (int i = 0; i < sk->w * sk->h * 4; i++)
+        dist[i] = -1;
+
+    int head = 0, tail = 0, box = from, node = -1;
+    while (true)
+    {
+        // Região do jogador com a caixa no lugar, e os empurrões a partir dela
+        const int g = node < 0 ? 0 : dist[node];
+        blk[box] = 1;
+        flood(node < 0 ? player : box - sk->offsets[node & 3], blk, seen, fill);
+        blk[box] = 0;
+        for (int d = 0; d < 4; d++)
+        {
+            const int t = box + sk->offsets[d], n = t * 4 + d;
+            if (!seen[box - sk->offsets[d]] || sk->board[t] == wall || blk[t] || !sk->live[t] || dist[n] >= 0)
+                continue;
+            dist[n] = g + 1;
+            prev[n] = node;
+            queue[tail++] = n;
+        }
+        if (head == tail)
+            break;
+        node = queue[head++];
+        box = node / 4;
+    }
+
+    free(seen);
+    free(fill);
+    free(queue);
+}
+
+// Marca em blk tudo o que não é a sala r nem a porta (o jogador fica preso atrás da caixa)
+static void room_block(int r, int door, uint8_t *blk)
+{
+    for (int i = 0; i < sk->w * sk->h; i++)
+        blk[i] = sk->room_of[i] != r && i != door;
+}
+
+// Empurrões da caixa na porta da sala r, com o jogador de fora entrando na direção d (ver box_bfs)
+// Retorna false se a casa de onde o jogador empurraria for parede ou da própria sala
+static bool room_entry(int r, int door, int d, uint8_t *blk, int *dist, int *prev)
+{
+    const int x = door - sk->offsets[d];
+    if (sk->board[x] == wall || sk->room_of[x] == r)
+        return false;
+    blk[x] = 0;
+    box_bfs(door, x, blk, dist, prev);
+    blk[x] = 1;
+    return true;
+}
+
+// Ordem de preenchimento das n metas (goal_list) da sala r, gravada a partir de room_seq[first]
+// Retorna false se a escolha gulosa chegar a um ponto em que nenhuma meta livre serve
+static bool room_order(int r, int door, const int *goal_list, int n, int first, uint8_t *blk, int *dist, int *prev)
+{
+    int *depth = malloc(n * sizeof(int));
+    bool *used = calloc(n, sizeof(bool)), *hit = malloc(n * sizeof(bool));
+    assert(depth && used && hit);
+    room_block(r, door, blk);
+    bool ok = true;
+
+    for (int m = 0; m < n && ok; m++)
+    {
+        // Empurrões até cada meta livre, pela melhor entrada, com as metas anteriores ocupadas
+        for (int j = 0; j < n; j++)
+            depth[j] = -1;
+        for (int d = 0; d < 4; d++)
+            if (room_entry(r, door, d, blk, dist, prev))
+                for (int j = 0; j < n; j++)
+                    for (int e = 0; e < 4; e++)
+                    {
+                        const int v = dist[goal_list[j] * 4 + e];
+                        if (!used[j] && v >= 0 && (depth[j] < 0 || v < depth[j]))
+                            depth[j] = v;
+                    }
+
+        // A meta mais funda que, ocupada, ainda deixa todas as outras alcançáveis
+        int pick = -1;
+        while (pick < 0)
+        {
+            int j = -1;
+            for (int k = 0; k < n; k++)
+                if (depth[k] >= 0 && (j < 0 || depth[k] > depth[j]))
+                    j = k;
+            if (j < 0)
+                break;
+            blk[goal_list[j]] = 1;
+            for (int k = 0; k < n; k++)
+                hit[k] = used[k] || k == j;
+            for (int d = 0; d < 4; d++)
+                if (room_entry(r, door, d, blk, dist, prev))
+                    for (int k = 0; k < n; k++)
+                        for (int e = 0; e < 4; e++)
+                            hit[k] |= dist[goal_list[k] * 4 + e] >= 0;
+            blk[goal_list[j]] = 0;
+            bool all = true;
+            for (int k = 0; k < n; k++)
+                all &= hit[k];
+            if (all)
+                pick = j;
+            else
+                depth[j] = -1; // Bloquearia outra meta: tenta a próxima mais funda
+        }
+        ok = pick >= 0;
+        if (!ok)
+            break;
+
+        // Registra a meta e, para cada direção de entrada, onde termina o caminho mais curto até ela
+        const int g = goal_list[pick];
+        sk->room_seq[first + m] = g;
+        sk->goal_rank[g] = m;
+        for (int d = 0; d < 4; d++)
+        {
+            int *e = sk->room_macro + ((size_t)(first + m) * 4 + d) * 2;
+            e[0] = -1, e[1] = 0;
+            if (room_entry(r, door, d, blk, dist, prev))
+                for (int f = 0; f < 4; f++)
+                {
+                    const int v = dist[g * 4 + f];
+                    if (v >= 0 && (e[0] < 0 || v < e[1]))
+                        e[0] = g - sk->offsets[f], e[1] = v;
+                }
+        }
+        used[pick] = true;
+        blk[g] = 1;
+    }
+
+    free(depth);
+    free(used);
+    free(hit);
+    return ok;
+}
+
+// Sala candidata: a porta, uma casa da região e o tamanho dela
+typedef struct
+{
+    int door, seed, size;
+} room_cand_t;
+
+static int cmp_room_size(const void *a, const void *b)
+{
+    return ((const room_cand_t *)b)->size - ((const room_cand_t *)a)->size;
+}
+
+// Marca com `label` em comp a região de casas não parede ligada a `seed` (sem passar pelas casas já
+// marcadas); guarda as casas em cells e retorna quantas são
+static int label_region(int seed, int label, int *comp, int *cells)
+{
+    int head = 0, tail = 0;
+    comp[seed] = label;
+    cells[tail++] = seed;
+    while (head < tail)
+    {
+        const int c = cells[head++];
+        for (int d = 0; d < 4; d++)
+        {
+            const int n = c + sk->offsets[d];
+            if (n < 0 || n >= sk->w * sk->h || sk->board[n] == wall || comp[n])
+                continue;
+            comp[n] = label;
+            cells[tail++] = n;
+        }
+    }
+    return tail;
+}
+
+// Acha os corredores, as salas de metas e a ordem de preenchimento de cada sala
+// Precisa de board, goals, live, offsets e n_goals (init_goal_dist)
+void init_macros()
+{
+    const int cells = sk->w * sk->h;
+    sk->corridor = calloc(cells, sizeof(uint8_t));
+    sk->room_of = calloc(cells, sizeof(int));
+    sk->door_of = calloc(cells, sizeof(int));
+    sk->goal_rank = malloc(cells * sizeof(int));
+    sk->room_first = calloc(sk->n_goals + 1, sizeof(int));
+    sk->room_seq = malloc((sk->n_goals + 1) * sizeof(int));
+    sk->room_macro = malloc(((size_t)sk->n_goals * 8 + 1) * sizeof(int));
+    assert(sk->corridor && sk->room_of && sk->door_of && sk->goal_rank && sk->room_first && sk->room_seq && sk->room_macro);
+
+    for (int c = 0; c < cells; c++)
+    {
+        sk->goal_rank[c] = -1;
+        if (sk->board[c] == wall)
+            continue;
+        const bool left = c % sk->w == 0 || sk->board[c - 1] == wall, right = c % sk->w == sk->w - 1 || sk->board[c + 1] == wall;
+        const bool up = c < sk->w || sk->board[c - sk->w] == wall, down = c >= cells - sk->w || sk->board[c + sk->w] == wall;
+        sk->corridor[c] = (left && right) | (up && down) << 1;
+    }
+
+    // Candidatas: sem cada casa viva, as regiões que sobram; a menor com metas (e não grande
+    // demais) é a sala daquela porta
+    int *comp = malloc(cells * sizeof(int)), *list = malloc(cells * sizeof(int));
+    size_t n_cand = 0, cap_cand = 16;
+    room_cand_t *cand = malloc(cap_cand * sizeof(room_cand_t));
+    assert(comp && list && cand);
+    for (int a = 0; a < cells; a++)
+    {
+        if (sk->board[a] == wall || !sk->live[a])
+            continue;
+        memset(comp, 0, cells * sizeof(int));
+        comp[a] = -1;
+        int n_comp = 0, best = -1, best_size = 0;
+        for (int d = 0; d < 4; d++)
+        {
+            const int s = a + sk->offsets[d];
+            if (sk->board[s] == wall || comp[s])
+                continue;
+            const int size = label_region(s, ++n_comp, comp, list);
+            bool has_goal = false;
+            for (int i = 0; i < size && !has_goal; i++)
+                has_goal = sk->goals[list[i]];
+            if (has_goal && size <= MAX_ROOM_CELLS && (best < 0 || size < best_size))
+                best = s, best_size = size;
+        }
+        if (n_comp < 2 || best < 0)
+            continue;
+        if (n_cand == cap_cand)
+            cand = realloc(cand, (cap_cand *= 2) * sizeof(room_cand_t));
+        cand[n_cand++] = (room_cand_t){a, best, best_size};
+    }
+
+    // As maiores primeiro; uma sala que se sobrepõe a outra já aceita (sala dentro de sala) fica de fora
+    qsort(cand, n_cand, sizeof(room_cand_t), cmp_room_size);
+    uint8_t *blk = malloc(cells);
+    int *dist = malloc((size_t)cells * 4 * sizeof(int)), *prev = malloc((size_t)cells * 4 * sizeof(int));
+    int *goal_list = malloc((sk->n_goals + 1) * sizeof(int));
+    assert(blk && dist && prev && goal_list);
+    sk->n_rooms = 0;
+    for (size_t i = 0; i < n_cand; i++)
+    {
+        const int door = cand[i].door;
+        memset(comp, 0, cells * sizeof(int));
+        comp[door] = -1;
+        const int size = label_region(cand[i].seed, 1, comp, list);
+        bool free_cells = !sk->room_of[door] && !sk->door_of[door];
+        for (int k = 0; k < size && free_cells; k++)
+            free_cells = !sk->room_of[list[k]] && !sk->door_of[list[k]];
+        if (!free_cells)
+            continue;
+
+        const int r = ++sk->n_rooms;
+        int n = 0;
+        for (int k = 0; k < size; k++)
+        {
+            sk->room_of[list[k]] = r;
+            if (sk->goals[list[k]])
+                goal_list[n++] = list[k];
+        }
+        sk->door_of[door] = r;
+        sk->room_first[r] = sk->room_first[r - 1] + n;
+        if (!room_order(r, door, goal_list, n, sk->room_first[r - 1], blk, dist, prev))
+        {
+            // Sem ordem que sirva: a região volta a ser comum
+            for (int k = 0; k < size; k++)
+                sk->room_of[list[k]] = 0, sk->goal_rank[list[k]] = -1;
+            sk->door_of[door] = 0;
+            sk->n_rooms--;
+        }
+    }
+
+    free(comp);
+    free(list);
+    free(cand);
+    free(blk);
+    free(dist);
+    free(prev);
+    free(goal_list);
+}
+
+// Estende o empurrão da caixa em b (estado c) na direção d numa macro, se houver: atravessa o túnel
+// e, se a caixa chegar de fora à porta de uma sala, a leva à próxima meta da sala. occ marca as
+// caixas de c. Retorna o destino da caixa; *player recebe onde o jogador termina e *pushes os empurrões
+int macro_push(const cidx_t *c, int b, int d, const uint8_t *occ, int *player, int *pushes)
+{
+    const uint8_t side = 1 << (d < 2); // paredes acima e abaixo (empurrão horizontal) ou dos lados
+    int to = b + sk->offsets[d], n = 1;
+    while (!sk->goals[to] && !sk->door_of[to] && (sk->corridor[to] & side) && (sk->corridor[to - sk->offsets[d]] & side))
+    {
+        const int next = to + sk->offsets[d];
+        if (sk->board[next] == wall || occ[next] || !sk->live[next])
+            break;
+        to = next, n++;
+    }
+    *player = to - sk->offsets[d];
+    *pushes = n;
+
+    const int r = sk->door_of[to];
+    if (!r || sk->room_of[*player] == r)
+        return to;
+    // A sala só pode ter as caixas das primeiras metas da ordem
+    int m = 0;
+    for (int k = 1; k <= sk->n_boxes; k++)
+        m += sk->room_of[c[k]] == r;
+    for (int k = 1; k <= sk->n_boxes; k++)
+        if (sk->room_of[c[k]] == r && (sk->goal_rank[c[k]] < 0 || sk->goal_rank[c[k]] >= m))
+            return to;
+    const int i = sk->room_first[r - 1] + m;
+    const int *e = sk->room_macro + ((size_t)i * 4 + d) * 2;
+    if (i >= sk->room_first[r] || e[0] < 0)
+        return to;
+    *player = e[0];
+    *pushes = n + e[1];
+    return sk->room_seq[i];
+}
+
+// Gera todos os empurrões possíveis a partir da região do jogador no i-ésimo estado da camada
+bool do_push(search_t *se, size_t i, worker_t *wk)
+{
+    const cidx_t *c = row(&se->level, i);
+    bool found = false;
+    for (int k = 1; k <= sk->n_boxes; k++)
+        wk->occ[c[k]] = 1;
+    flood(c[0], wk->occ, wk->seen, wk->queue);
+
+    for (int k = 1; k <= sk->n_boxes && !found; k++)
+    {
+        const int b = c[k];
+        for (int d = 0; d < 4 && !found; d++)
+        {
+            const int t = b + sk->offsets[d]; // destino da caixa
+            if (!wk->seen[b - sk->offsets[d]] || sk->board[t] == wall || wk->occ[t])
+                continue;
+            if (!sk->live[t])
+            {
+                TELE(live_pruned, 1);
+                continue;
+            }
+            hash_t nh;
+            int to = t, player = b, pushes = 1;
+            if (sk->macros)
+                to = macro_push(c, b, d, wk->occ, &player, &pushes);
+            if (move_box(c, se->level.hashes[i], b, to, player, true, wk->succ, &nh, wk))
+                found = queue_move(se, wk->succ, nh, make_key(se->depth + 1, i, (k - 1) * 4 + d), wk);
+        }
+    }
+
+    for (int k = 1; k <= sk->n_boxes; k++)
+        wk->occ[c[k]] = 0;
+    return found;
+}
+
+// Gera todas as puxadas possíveis a partir da região do jogador no i-ésimo estado (busca reversa)
+// O jogador em `at`, com a caixa em `at + offsets[d]`, recua para `at - offsets[d]` e traz a caixa para `at`
+bool do_pull(search_t *se, size_t i, worker_t *wk)
+{
+    const cidx_t *c = row(&se->level, i);
+    bool found = false;
+    for (int k = 1; k <= sk->n_boxes; k++)
+        wk->occ[c[k]] = 1;
+    flood(c[0], wk->occ, wk->seen, wk->queue);
+
+    for (int k = 1; k <= sk->n_boxes && !found; k++)
+    {
+        const int b = c[k];
+        for (int d = 0; d < 4 && !found; d++)
+        {
+            const int at = b - sk->offsets[d], back = at - sk->offsets[d];
+            if (!wk->seen[at] || !sk->live[at] || sk->board[back] == wall || wk->occ[back])
+                continue;
+            hash_t nh;
+            if (move_box(c, se->level.hashes[i], b, at, back, false, wk->succ, &nh, wk))
+                found = queue_move(se, wk->succ, nh, make_key(se->depth + 1, i, (k - 1) * 4 + d), wk);
+        }
+    }
+
+    for (int k = 1; k <= sk->n_boxes; k++)
+        wk->occ[c[k]] = 0;
+    return found;
+}
+
+// Faixa de CHUNK estados da camada e onde ficaram os sucessores gerados a partir dela
+typedef struct
+{
+    int thread;    // thread que expandiu a faixa
+    size_t start;  // primeiro sucessor da faixa na lista cand da thread
+    size_t count;  // sucessores gerados pela faixa
+    size_t kept;   // sucessores de que a faixa é dona (vão para a próxima camada)
+    size_t offset; // posição do primeiro deles na próxima camada
+} range_t;
+
+// Função para expandir uma camada inteira da busca em largura
+// Fase 1: as faixas da camada são distribuídas entre as threads e cada thread guarda, na sua
+// lista, os sucessores que gerou com a chave de geração. Fase 2 (depois da barreira): cada faixa
+// fica só com os sucessores de que é dona e as faixas são copiadas, em ordem, para a próxima
+// camada. O resultado é a mesma camada de uma BFS FIFO sequencial, com qualquer número de threads.
+void expand_level(search_t *se)
+{
+    frontier_t *level = &se->level;
+    const size_t n = level->n, n_ranges = (n + CHUNK - 1) / CHUNK;
+    const size_t row_bytes = (1 + sk->n_boxes) * sizeof(cidx_t);
+    range_t *ranges = malloc(n_ranges * sizeof(range_t));
+    assert(ranges);
+    assert(se->depth + 1 < (1 << (64 - KEY_DEPTH_SHIFT)));
+    frontier_t next;
+#ifdef TELEMETRY
+    layer_stats_t ls = {.depth = se->depth + 1, .backward = se->backward, .frontier = n, .dl_pruned = total_dl_pruned()};
+    double t0 = omp_get_wtime();
+    tele_begin_layer();
+#endif
+
+    reserve_table(&se->table, 4 * n * (sk->push_mode ? sk->n_boxes : 1)); // No máximo 4 sucessores por estado (4 por caixa no modo de empurrões)
+#ifdef TELEMETRY
+    ls.table_ms = (omp_get_wtime() - t0) * 1000;
+    t0 = omp_get_wtime();
+#endif
+    sk->best_key = UINT64_MAX;
+    for (int t = 0; t < sk->n_workers; t++)
+        sk->workers[t].n_cand = 0;
+
+#pragma omp parallel copyin(sk)
+    {
+        const int tid = omp_get_thread_num();
+        worker_t *wk = &sk->workers[tid];
+
+#pragma omp for schedule(dynamic, 1)
+        for (size_t r = 0; r < n_ranges; r++)
+        {
+            const size_t end = (r + 1) * CHUNK < n ? (r + 1) * CHUNK : n;
+#ifdef TELEMETRY
+            if (!wk->tele.start)
+                wk->tele.start = omp_get_wtime();
+#endif
+            ranges[r].thread = tid;
+            ranges[r].start = wk->n_cand;
+            for (size_t i = r * CHUNK; i < end; i++)
+            {
+                // Depois do pai da melhor solução já achada, nada muda a resposta
+                if (i > key_parent(__atomic_load_n(&sk->best_key, __ATOMIC_RELAXED)))
+                    break;
+                if (se->backward)
+                    do_pull(se, i, wk);
+                else if (sk->push_mode)
+                    do_push(se, i, wk);
+                else
+                    do_move(se, i, wk);
+            }
+            ranges[r].count = wk->n_cand - ranges[r].start;
+#ifdef TELEMETRY
+            wk->tele.end = omp_get_wtime();
+#endif
+        }
+
+        // Conta os sucessores de que cada faixa é dona (as chaves já não mudam depois da barreira)
+#pragma omp for schedule(dynamic, 16)
+        for (size_t r = 0; r < n_ranges; r++)
+        {
+            const cand_t *c = sk->workers[ranges[r].thread].cand + ranges[r].start;
+            size_t kept = 0;
+            for (size_t k = 0; k < ranges[r].count; k++)
+                kept += state_at(c[k].ref)->owner == c[k].key;
+            ranges[r].kept = kept;
+        }
+
+#pragma omp single
+        {
+            size_t total = 0;
+            for (size_t r = 0; r < n_ranges; r++)
+            {
+                ranges[r].offset = total;
+                total += ranges[r].kept;
+            }
+            alloc_frontier(&next, total);
+        }
+
+        // Copia os sucessores para a próxima camada, na ordem das faixas
+#pragma omp for schedule(dynamic, 16)
+        for (size_t r = 0; r < n_ranges; r++)
+        {
+            const cand_t *c = sk->workers[ranges[r].thread].cand + ranges[r].start;
+            size_t j = ranges[r].offset;
+            for (size_t k = 0; k < ranges[r].count; k++)
+            {
+                state_t *st = state_at(c[k].ref);
+                if (st->owner != c[k].key)
+                    continue;
+                const size_t parent = key_parent(c[k].key);
+                st->prev = level->refs[parent]; // O pai é sempre o dono, não quem alocou o estado
+                memcpy(row(&next, j), st->c, row_bytes);
+                next.hashes[j] = c[k].h;
+                next.refs[j] = c[k].ref;
+                next.parent[j] = parent;
+                if (c[k].key == sk->best_key)
+                    sk->done = c[k].ref, sk->done_side = se;
+                j++;
+            }
+        }
+    }
+
+    free(ranges);
+    free_frontier(level);
+    *level = next;
+    se->table.filled += next.n;
+    se->depth++;
+#ifdef TELEMETRY
+    ls.kept = next.n;
+    ls.dl_pruned = total_dl_pruned() - ls.dl_pruned;
+    ls.expand_ms = (omp_get_wtime() - t0) * 1000;
+    tele_end_layer(&ls);
+#endif
+}
+
+/*----------- Busca bidirecional -----------*/
+
+#define MAX_GOAL_CONFIGS 100000 // limite de combinações de metas para a primeira camada reversa
+
+// Monta a primeira camada do lado para trás: as caixas em cada combinação de metas e, para cada
+// combinação, o jogador em cada região livre do chão que ele pode pisar. Com combinações demais,
+// marca failed e não monta nada.
+void init_backward()
+{
+    worker_t *wk = &sk->workers[0];
+    int n_goals = 0;
+    for (int i = 0; i < sk->w * sk->h; i++)
+        n_goals += sk->goals[i];
+
+    // Quantidade de combinações C(n_goals, n_boxes), interrompida se passar do limite
+    double combos = 1;
+    for (int k = 0; k < sk->n_boxes; k++)
+        combos = combos * (n_goals - k) / (k + 1);
+    if (combos > MAX_GOAL_CONFIGS)
+    {
+        fprintf(stderr, "Busca bidirecional: %.0f combinações de metas (limite %d)\n", combos, MAX_GOAL_CONFIGS);
+        sk->failed = true;
+        return;
+    }
+
+    int *goal_list = malloc(n_goals * sizeof(int));
+    int *pick = malloc((sk->n_boxes + 1) * sizeof(int));
+    uint8_t *floor = malloc(sk->w * sk->h), *region = malloc(sk->w * sk->h);
+    size_t cap = 64, n = 0;
+    sidx_t *roots = malloc(cap * sizeof(sidx_t));
+    assert(goal_list && pick && floor && region && roots);
+
+    for (int i = 0, j = 0; i < sk->w * sk->h; i++)
+        if (sk->goals[i])
+            goal_list[j++] = i;
+
+    // Chão: células que o jogador alcança a partir do início se as caixas não existissem
+    flood(sk->start_player, wk->occ, wk->seen2, wk->queue);
+    memcpy(floor, wk->seen2, sk->w * sk->h);
+
+    for (int k = 0; k < sk->n_boxes; k++)
+        pick[k] = k;
+    while (sk->n_boxes <= n_goals)
+    {
+        for (int k = 0; k < sk->n_boxes; k++)
+            wk->occ[goal_list[pick[k]]] = 1;
+        memset(region, 0, sk->w * sk->h);
+
+        for (int c = 0; c < sk->w * sk->h; c++)
+        {
+            if (!floor[c] || wk->occ[c] || region[c])
+                continue;
+            const sidx_t ri = newstate(0);
+            state_t *r = state_at(ri);
+            r->c[0] = flood(c, wk->occ, wk->seen, wk->queue);
+            for (int i = 0; i < sk->w * sk->h; i++)
+                region[i] |= wk->seen[i];
+            for (int k = 0; k < sk->n_boxes; k++)
+                r->c[k + 1] = goal_list[pick[k]];
+            r->owner = make_key(0, n, 0);
+
+            if (n == cap)
+            {
+                roots = realloc(roots, (cap *= 2) * sizeof(sidx_t));
+                assert(roots);
+            }
+            roots[n++] = ri;
+        }
+
+        for (int k = 0; k < sk->n_boxes; k++)
+            wk->occ[goal_list[pick[k]]] = 0;
+
+        // Próxima combinação em ordem lexicográfica
+        int k = sk->n_boxes - 1;
+        while (k >= 0 && pick[k] == n_goals - sk->n_boxes + k)
+            k--;
+        if (k < 0)
+            break;
+        pick[k]++;
+        for (int j = k + 1; j < sk->n_boxes; j++)
+            pick[j] = pick[j - 1] + 1;
+    }
+
+    reserve_table(&sk->bwd.table, n);
+    alloc_frontier(&sk->bwd.level, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        const cidx_t *c = state_at(roots[i])->c;
+        sidx_t f;
+        sk->bwd.level.hashes[i] = hash(c);
+        insert_if_absent(&sk->bwd.table, roots[i], sk->bwd.level.hashes[i], &f);
+        memcpy(row(&sk->bwd.level, i), c, (1 + sk->n_boxes) * sizeof(cidx_t));
+        sk->bwd.level.refs[i] = roots[i];
+        sk->bwd.level.parent[i] = 0;
+    }
+    sk->bwd.table.filled = n;
+    sk->bwd.backward = true;
+    sk->bwd.other = &sk->fwd;
+    sk->fwd.other = &sk->bwd;
+
+    free(goal_list);
+    free(pick);
+    free(floor);
+    free(region);
+    free(roots);
+}
+
+/*----------- Checkpoints da busca em largura -----------*/
+
+/* Com -c arquivo, a busca em largura grava um checkpoint numa barreira entre camadas sempre que
+   passam ckp_interval segundos desde o último. Na barreira só são copiados os índices dos estados
+   visitados (varrendo a tabela) e os da camada atual; os registros desses estados não mudam mais,
+   então uma thread em segundo plano os grava (posições, pai e índice) enquanto a busca continua.
+   O arquivo é escrito com outro nome e renomeado no fim, então o último checkpoint completo nunca é
+   perdido. Com -r arquivo, o nível, o modo de busca e os testes de deadlock vêm do checkpoint, os
+   registros voltam aos mesmos índices nas arenas (os pais continuam valendo), a tabela é refeita e a
+   busca continua a partir da camada gravada. */
+
+#define CKP_MAGIC "SOKOCKP2"
+
+// Cabeçalho do arquivo; depois dele vêm o nível (w * h bytes), os estados visitados (índice, pai e
+// posições) e os índices dos estados da camada atual
+typedef struct
+{
+    char magic[8];
+    int32_t w, h, n_boxes;
+    int32_t push_mode, deadlock_checks, start_player;
+    int32_t macros;     // busca com macros (-u)
+    int32_t depth;      // profundidade da camada gravada
+    uint32_t n_slabs;   // blocos de estados que existiam (os índices gravados cabem neles)
+    uint64_t n_states;  // estados visitados
+    uint64_t n_level;   // estados da camada atual
+} ckp_header_t;
+
+// Trabalho da thread de gravação: o cabeçalho e as listas copiadas na barreira
+typedef struct
+{
+    ckp_header_t hd;
+    sidx_t *states;
+    sidx_t *level;
+    sokoban_t *ctx; // contexto da busca (a thread de gravação não tem o sk da equipe)
+} ckp_job_t;
+
+// Grava o checkpoint descrito em arg (corre numa thread própria, em paralelo com a busca)
+static void *ckp_write(void *arg)
+{
+    ckp_job_t *job = arg;
+    sk = job->ctx;
+    const size_t row_bytes = (1 + sk->n_boxes) * sizeof(cidx_t);
+    char *tmp = malloc(strlen(sk->ckp_path) + 5);
+    assert(tmp);
+    sprintf(tmp, "%s.tmp", sk->ckp_path);
+
+    FILE *f = fopen(tmp, "wb");
+    bool ok = f != NULL;
+    if (ok)
+    {
+        ok = fwrite(&job->hd, sizeof(job->hd), 1, f) == 1 && fwrite(sk->level_text, (size_t)sk->w * sk->h, 1, f) == 1;
+        for (size_t i = 0; ok && i < job->hd.n_states; i++)
+        {
+            const state_t *s = state_at(job->states[i]);
+            ok = fwrite(&job->states[i], sizeof(sidx_t), 1, f) == 1 && fwrite(&s->prev, sizeof(sidx_t), 1, f) == 1 &&
+                 fwrite(s->c, row_bytes, 1, f) == 1;
+        }
+        ok = ok && fwrite(job->level, sizeof(sidx_t), job->hd.n_level, f) == job->hd.n_level;
+        ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+        ok = fclose(f) == 0 && ok;
+    }
+    if (ok && rename(tmp, sk->ckp_path) == 0)
+        fprintf(stderr, "Checkpoint da camada %d gravado em %s\n", job->hd.depth, sk->ckp_path);
+    else
+    {
+        perror(tmp);
+        unlink(tmp);
+    }
+
+    free(tmp);
+    free(job->states);
+    free(job->level);
+    free(job);
+    __atomic_store_n(&sk->ckp_busy, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Espera a gravação em andamento, se houver
+void ckp_wait()
+{
+    if (sk->ckp_running)
+        pthread_join(sk->ckp_thread, NULL);
+    sk->ckp_running = false;
+}
+
+// Na barreira entre camadas: se já passou o intervalo e a gravação anterior terminou, copia os
+// índices dos estados visitados e da camada atual e dispara a gravação em segundo plano
+void ckp_maybe_save()
+{
+    if (omp_get_wtime() - sk->ckp_last < sk->ckp_interval || __atomic_load_n(&sk->ckp_busy, __ATOMIC_ACQUIRE))
+        return;
+    ckp_wait();
+    sk->ckp_last = omp_get_wtime();
+
+    ckp_job_t *job = malloc(sizeof(ckp_job_t));
+    const table_t *t = &sk->fwd.table;
+    job->states = malloc((t->filled + 1) * sizeof(sidx_t));
+    job->level = malloc((sk->fwd.level.n + 1) * sizeof(sidx_t));
+    assert(job && job->states && job->level);
+
+    // Na barreira ninguém migra: as posições de old antes de next_chunk já estão no vetor novo
+    size_t n = 0;
+    for (size_t i = 0; i < t->size; i++)
+        if (t->slots[i])
+            job->states[n++] = (sidx_t)t->slots[i];
+    for (size_t i = t->next_chunk; t->old && i < t->old_size; i++)
+        if (t->old[i])
+            job->states[n++] = (sidx_t)t->old[i];
+    assert(n == t->filled);
+    memcpy(job->level, sk->fwd.level.refs, sk->fwd.level.n * sizeof(sidx_t));
+
+    ckp_header_t *hd = &job->hd;
+    memset(hd, 0, sizeof(*hd));
+    memcpy(hd->magic, CKP_MAGIC, sizeof(hd->magic));
+    hd->w = sk->w, hd->h = sk->h, hd->n_boxes = sk->n_boxes;
+    hd->push_mode = sk->push_mode, hd->deadlock_checks = sk->deadlock_checks, hd->start_player = sk->start_player;
+    hd->macros = sk->macros;
+    hd->depth = sk->fwd.depth;
+    hd->n_slabs = sk->n_slabs;
+    hd->n_states = n;
+    hd->n_level = sk->fwd.level.n;
+    job->ctx = sk;
+
+    sk->ckp_busy = 1;
+    if (pthread_create(&sk->ckp_thread, NULL, ckp_write, job))
+    {
+        fprintf(stderr, "Não foi possível iniciar a gravação do checkpoint\n");
+        free(job->states);
+        free(job->level);
+        free(job);
+        sk->ckp_busy = 0;
+        return;
+    }
+    sk->ckp_running = true;
+}
+
+// Abre o checkpoint de resume_path e lê o cabeçalho; sai do programa se o arquivo não servir
+FILE *ckp_open(ckp_header_t *hd)
+{
+    FILE *f = fopen(sk->resume_path, "rb");
+    if (!f)
+    {
+        perror(sk->resume_path);
+        exit(2);
+    }
+    if (fread(hd, sizeof(*hd), 1, f) != 1 || memcmp(hd->magic, CKP_MAGIC, sizeof(hd->magic)))
+    {
+        fprintf(stderr, "%s não é um checkpoint válido\n", sk->resume_path);
+        exit(2);
+    }
+    return f;
+}
+
+// Lê o nível gravado no checkpoint e adota o modo de busca e os testes de deadlock dele
+// Retorna o nível (string retangular, como a de pad_level) e define w e h
+char *ckp_read_level()
+{
+    ckp_header_t hd;
+    FILE *f = ckp_open(&hd);
+    sk->w = hd.w, sk->h = hd.h;
+    sk->push_mode = hd.push_mode;
+    sk->deadlock_checks = hd.deadlock_checks;
+    sk->macros = hd.macros;
+    char *text = malloc((size_t)sk->w * sk->h + 1);
+    assert(text);
+    if (fread(text, (size_t)sk->w * sk->h, 1, f) != 1)
+    {
+        fprintf(stderr, "%s está incompleto\n", sk->resume_path);
+        exit(2);
+    }
+    text[(size_t)sk->w * sk->h] = '\0';
+    fclose(f);
+    return text;
+}
+
+// Restaura os estados visitados, a tabela e a camada atual do checkpoint (depois de preparar o nível)
+void ckp_load()
+{
+    ckp_header_t hd;
+    FILE *f = ckp_open(&hd);
+    const size_t row_bytes = (1 + sk->n_boxes) * sizeof(cidx_t);
+    assert(hd.n_boxes == sk->n_boxes && hd.n_slabs <= MAX_SLABS);
+    fseek(f, (long)((size_t)sk->w * sk->h), SEEK_CUR);
+    sk->start_player = hd.start_player;
+
+    // Os blocos voltam com a mesma numeração, e as arenas recomeçam em blocos novos
+    while (sk->n_slabs < hd.n_slabs)
+    {
+        sk->slab_dir[sk->n_slabs] = slab_memory(sk->n_slabs);
+        assert(sk->slab_dir[sk->n_slabs]);
+        sk->n_slabs++;
+    }
+    for (int t = 0; t < sk->n_workers; t++)
+        sk->workers[t].arena.cur = sk->workers[t].arena.end = 0, sk->workers[t].arena.free_list = 0;
+
+    sidx_t *states = malloc((hd.n_states + 1) * sizeof(sidx_t));
+    assert(states);
+    bool ok = true;
+    for (size_t i = 0; ok && i < hd.n_states; i++)
+    {
+        sidx_t prev;
+        ok = fread(&states[i], sizeof(sidx_t), 1, f) == 1 && fread(&prev, sizeof(sidx_t), 1, f) == 1 &&
+             (states[i] >> SLAB_SHIFT) < hd.n_slabs;
+        if (!ok)
+            break;
+        state_t *s = state_at(states[i]);
+        s->prev = prev;
+        s->owner = make_key(0, 0, 0); // Visitado antes de qualquer camada nova
+        ok = fread(s->c, row_bytes, 1, f) == 1;
+    }
+    alloc_frontier(&sk->fwd.level, hd.n_level);
+    ok = ok && fread(sk->fwd.level.refs, sizeof(sidx_t), hd.n_level, f) == hd.n_level;
+    fclose(f);
+    if (!ok)
+    {
+        fprintf(stderr, "%s está incompleto\n", sk->resume_path);
+        exit(2);
+    }
+
+    reserve_table(&sk->fwd.table, hd.n_states);
+#pragma omp parallel for schedule(static) copyin(sk)
+    for (size_t i = 0; i < hd.n_states; i++)
+    {
+        sidx_t e;
+        insert_if_absent(&sk->fwd.table, states[i], hash(state_at(states[i])->c), &e);
+    }
+    sk->fwd.table.filled = hd.n_states;
+#pragma omp parallel for schedule(static) copyin(sk)
+    for (size_t j = 0; j < hd.n_level; j++)
+    {
+        memcpy(row(&sk->fwd.level, j), state_at(sk->fwd.level.refs[j])->c, row_bytes);
+        sk->fwd.level.hashes[j] = hash(row(&sk->fwd.level, j));
+        sk->fwd.level.parent[j] = 0;
+    }
+    sk->fwd.depth = hd.depth;
+    free(states);
+    printf("Retomando da camada %d (%zu estados visitados, %zu na camada)\n", sk->fwd.depth, (size_t)hd.n_states, (size_t)hd.n_level);
+}
+
+// Expande camadas até achar o final (done) ou esgotar os estados, gravando checkpoints com -c
+void bfs_layers()
+{
+    // Enquanto o jogo não for resolvido, continua tentando encontrar a solução
+    while (!sk->done) // Enquanto não tiver terminado
+    {
+        // Expande a camada atual em paralelo, gerando a próxima; na busca bidirecional, do lado menor
+        search_t *se = sk->bidirectional && sk->bwd.level.n < sk->fwd.level.n ? &sk->bwd : &sk->fwd;
+        expand_level(se);
+#ifdef TELEMETRY
+        tele_progress(se->depth, se->level.n, sk->fwd.table.filled + sk->bwd.table.filled);
+#endif
+
+        // Se não houver mais estados para explorar, significa que não há solução
+        if (!se->level.n)
+            break;
+        if (sk->ckp_path && !sk->done)
+            ckp_maybe_save();
+    }
+    ckp_wait(); // A gravação lê os registros, que só são liberados depois da busca
+}
+
+// Busca em largura por camadas a partir do estado inicial s, de hash hs (bidirecional com -b)
+// Deixa o estado final em done, ou 0 se não houver solução
+void bfs(sidx_t s, hash_t hs)
+{
+    sk->ckp_last = omp_get_wtime();
+    if (sk->resume_path) // Continua da camada gravada no checkpoint
+    {
+        ckp_load();
+        bfs_layers();
+        return;
+    }
+
+    // Cria a tabela de hash com espaço para o estado inicial
+    reserve_table(&sk->fwd.table, 1);
+    sk->fwd.table.filled = 1;
+
+    // A primeira camada tem só o estado inicial
+    sidx_t f;
+    const cidx_t *c = state_at(s)->c;
+    state_at(s)->owner = make_key(0, 0, 0);
+    insert_if_absent(&sk->fwd.table, s, hs, &f);
+    alloc_frontier(&sk->fwd.level, 1);
+    memcpy(row(&sk->fwd.level, 0), c, (1 + sk->n_boxes) * sizeof(cidx_t));
+    sk->fwd.level.hashes[0] = hs;
+    sk->fwd.level.refs[0] = s;
+    sk->fwd.level.parent[0] = 0;
+    if (success(c))
+        sk->done = s, sk->done_side = &sk->fwd;
+    else if (sk->bidirectional)
+        init_backward();
+    if (!sk->failed)
+        bfs_layers();
+}
+
+/*----------- Busca só com a fronteira -----------*/
+
+/* Modo econômico (-l N): a busca em largura guarda só as N últimas camadas (tabela e registros)
+   em vez de todos os estados visitados, então a memória acompanha a largura das maiores camadas e
+   não o total de estados. Sem os estados antigos não há cadeia de prev para refazer o caminho:
+   cada estado da fronteira carrega uma cópia do seu ancestral numa camada de revezamento. A
+   primeira busca usa as camadas 1, 2, 4, 8... como revezamento e acha a profundidade D, o estado
+   final e o ancestral dele na maior potência de 2 até D. Depois cada trecho de pontas conhecidas é
+   refeito por uma busca de uma ponta até a outra, com revezamento na camada do meio, e as metades
+   são refeitas recursivamente (lean_fill).
+   Um passo a pé se desfaz com o passo contrário, então um estado revisto só a pé ainda está na
+   janela; já os empurrões não se desfazem, e o mesmo estado pode reaparecer muitas camadas depois
+   (as mesmas caixas empurradas em outra ordem, por exemplo). Ele é expandido de novo: é trabalho a
+   mais, e camadas mais largas, mas o final continua aparecendo na menor profundidade. Quanto maior
+   N, menos repetidos escapam. Num nível sem solução essas voltas podem não acabar, então a busca
+   desiste na profundidade máxima da chave. */
+#define LEAN_MAX_DEPTH ((1 << (64 - KEY_DEPTH_SHIFT)) - 1) // profundidade máxima (limite da chave)
+
+// Verifica se as posições p (com hash h) estão em alguma camada da janela
+bool lean_seen(const cidx_t *p, hash_t h)
+{
+    for (int k = 0; k < sk->lean; k++)
+        if (sk->lean_window[k].slots && lookup(&sk->lean_window[k], p, h))
+            return true;
+    return false;
+}
+
+// Devolve os registros da camada às arenas (cada thread para a própria lista livre) e libera a tabela
+// As tabelas da janela não têm vetor antigo, então cada registro aparece uma vez em slots
+static void lean_drop(table_t *t)
+{
+#pragma omp parallel for schedule(static) copyin(sk)
+    for (size_t i = 0; i < t->size; i++)
+        if (t->slots[i])
+            unnewstate((sidx_t)t->slots[i]);
+    free_table(t);
+}
+
+// Põe a camada recém-gerada (fronteira de fwd) na janela, tirando a mais antiga
+// fwd fica com uma tabela vazia para a camada seguinte
+static void lean_push()
+{
+    lean_drop(&sk->lean_window[0]);
+    memmove(sk->lean_window, sk->lean_window + 1, (sk->lean - 1) * sizeof(table_t));
+
+    // A tabela da expansão foi dimensionada para todos os sucessores possíveis; a da janela só
+    // precisa caber a camada, então é refeita com o tamanho justo
+    table_t *t = &sk->lean_window[sk->lean - 1];
+    const frontier_t *level = &sk->fwd.level;
+    free_table(&sk->fwd.table);
+    memset(t, 0, sizeof(*t));
+    reserve_table(t, level->n);
+    t->filled = level->n;
+#pragma omp parallel for schedule(static) copyin(sk)
+    for (size_t i = 0; i < level->n; i++)
+    {
+        sidx_t f;
+        insert_if_absent(t, level->refs[i], level->hashes[i], &f);
+    }
+}
+
+// Busca em largura só com a fronteira, das posições from até as posições to (ou até um estado final,
+// se to é NULL). Cada estado carrega o ancestral na camada relay (nas camadas 1, 2, 4... se relay é 0)
+// Retorna a profundidade do final (-1 se não houver) e copia o final para goal e o ancestral dele para mid
+int lean_search(const cidx_t *from, const cidx_t *to, int relay, cidx_t *goal, cidx_t *mid)
+{
+    const size_t row_cells = 1 + sk->n_boxes, row_bytes = row_cells * sizeof(cidx_t);
+    sk->lean_target = to;
+    sk->done = 0;
+
+    // A primeira camada tem só o estado de partida, que é o seu próprio ancestral
+    const sidx_t s = newstate(0);
+    const hash_t hs = hash(from);
+    sidx_t f;
+    memcpy(state_at(s)->c, from, row_bytes);
+    state_at(s)->owner = make_key(0, 0, 0);
+    reserve_table(&sk->fwd.table, 1);
+    insert_if_absent(&sk->fwd.table, s, hs, &f);
+    sk->fwd.table.filled = 1;
+    sk->fwd.depth = 0;
+    alloc_frontier(&sk->fwd.level, 1);
+    memcpy(row(&sk->fwd.level, 0), from, row_bytes);
+    sk->fwd.level.hashes[0] = hs;
+    sk->fwd.level.refs[0] = s;
+    sk->fwd.level.parent[0] = 0;
+    cidx_t *relays = alloc_aligned(row_bytes);
+    assert(relays);
+    memcpy(relays, from, row_bytes);
+    sk->lean_visited++;
+    lean_push();
+
+    if (to ? !memcmp(from, to, row_bytes) : success(from))
+        sk->done = s;
+    while (!sk->done && sk->fwd.level.n && sk->fwd.depth + 1 < LEAN_MAX_DEPTH)
+    {
+        expand_level(&sk->fwd);
+        sk->lean_visited += sk->fwd.level.n;
+
+        // O ancestral vem do pai (parent é o índice dele na camada anterior), ou é o próprio estado
+        const int d = sk->fwd.depth;
+        const bool here = relay ? d == relay : !(d & (d - 1));
+        cidx_t *next = alloc_aligned(sk->fwd.level.n * row_bytes);
+        assert(next);
+#pragma omp parallel for schedule(static) copyin(sk)
+        for (size_t j = 0; j < sk->fwd.level.n; j++)
+            memcpy(next + j * row_cells, here ? row(&sk->fwd.level, j) : relays + sk->fwd.level.parent[j] * row_cells, row_bytes);
+        free(relays);
+        relays = next;
+        lean_push();
+    }
+
+    int depth = -1;
+    if (sk->done)
+    {
+        size_t j = 0;
+        while (sk->fwd.level.refs[j] != sk->done)
+            j++;
+        memcpy(goal, row(&sk->fwd.level, j), row_bytes);
+        memcpy(mid, relays + j * row_cells, row_bytes);
+        depth = sk->fwd.depth;
+    }
+
+    for (int k = 0; k < sk->lean; k++)
+        lean_drop(&sk->lean_window[k]);
+    free_frontier(&sk->fwd.level);
+    free(relays);
+    sk->lean_target = NULL;
+    sk->done = 0;
+    return depth;
+}
+
+// Preenche path[a + 1] até path[b - 1], sabendo que há b - a movimentos entre path[a] e path[b]
+void lean_fill(cidx_t *path, int a, int b)
+{
+    if (b - a < 2)
+        return;
+    const size_t row_cells = 1 + sk->n_boxes;
+    const int m = (a + b) / 2;
+    cidx_t *goal = malloc(row_cells * sizeof(cidx_t));
+    assert(goal);
+    const int d = lean_search(path + a * row_cells, path + b * row_cells, m - a, goal, path + m * row_cells);
+    assert(d == b - a);
+    free(goal);
+
+    lean_fill(path, a, m);
+    lean_fill(path, m, b);
+}
+
+// Resolve a partir do estado inicial s guardando só a fronteira; deixa a solução em lean_path
+void lean_bfs(sidx_t s)
+{
+    const size_t row_cells = 1 + sk->n_boxes, row_bytes = row_cells * sizeof(cidx_t);
+    cidx_t *goal = malloc(row_bytes), *mid = malloc(row_bytes);
+    sk->lean_window = calloc(sk->lean, sizeof(table_t));
+    assert(goal && mid && sk->lean_window);
+    const int depth = lean_search(state_at(s)->c, NULL, 0, goal, mid);
+    if (depth >= 0)
+    {
+        sk->lean_path = malloc((depth + 1) * row_bytes);
+        assert(sk->lean_path);
+        memcpy(sk->lean_path, state_at(s)->c, row_bytes);
+        memcpy(sk->lean_path + depth * row_cells, goal, row_bytes);
+
+        // O ancestral guardado está na maior potência de 2 até a profundidade (o próprio final se for igual)
+        int c = 1;
+        while (c * 2 <= depth)
+            c *= 2;
+        if (c < depth)
+        {
+            memcpy(sk->lean_path + c * row_cells, mid, row_bytes);
+            lean_fill(sk->lean_path, 0, c);
+            lean_fill(sk->lean_path, c, depth);
+        }
+        else
+            lean_fill(sk->lean_path, 0, depth);
+        sk->lean_len = depth + 1;
+    }
+    free(goal);
+    free(mid);
+    free(sk->lean_window);
+}
+
+#ifdef USE_MPI
+/*----------- Busca distribuída (MPI) -----------*/
+
+/* Busca em largura por passos ou empurrões distribuída entre processos MPI (compilada só com
+   -DUSE_MPI, ver "make mpi"), para níveis cuja tabela de visitados não cabe numa máquina. Cada
+   estado tem um processo dono, escolhido pelo hash (rank_of), que guarda o registro e a entrada
+   na tabela; cada processo expande só a sua parte da camada, com as threads de sempre. Os
+   sucessores vão para buffers por thread (mpi_queue) e, na barreira de cada camada, são trocados
+   em lote com MPI_Alltoallv: cada processo recebe os que são dele, descarta os repetidos na sua
+   tabela e forma a sua parte da camada seguinte. Como o pai de um estado pode estar em outro
+   processo, o registro guarda também o processo do pai, e o caminho é refeito com um MPI_Bcast
+   por estado, feito pelo dono de cada um. Com um único processo, a busca é a normal. */
+int mpi_rank, n_ranks = 1;      // processo atual e quantidade de processos
+
+// Sucessor enviado ao processo dono: hash, pai (registro no processo que o gerou) e posições
+typedef struct
+{
+    hash_t h;
+    sidx_t parent;
+    cidx_t c[];
+} mpi_rec_t;
+
+// Processo dono do estado de hash h (bits baixos; a tabela usa os altos)
+static inline int rank_of(hash_t h)
+{
+    return (uint32_t)h % n_ranks;
+}
+
+static inline mpi_rec_t *mpi_rec(uint8_t *buf, size_t k)
+{
+    return (mpi_rec_t *)(buf + k * sk->mpi_rec_size);
+}
+
+// Guarda o sucessor p (hash h, gerado com a chave key) no buffer de envio da thread
+// Os que são deste processo e já foram visitados são descartados aqui mesmo: durante a expansão
+// ninguém insere na tabela, então a consulta não precisa de sincronização
+void mpi_queue(search_t *se, const cidx_t *p, hash_t h, uint64_t key, worker_t *wk)
+{
+    if (rank_of(h) == mpi_rank && lookup(&se->table, p, h))
+    {
+        TELE(duplicates, 1);
+        return;
+    }
+    if (wk->n_out == wk->cap_out)
+    {
+        wk->cap_out = wk->cap_out ? wk->cap_out * 2 : 1024;
+        wk->out = realloc(wk->out, wk->cap_out * sk->mpi_rec_size);
+        assert(wk->out);
+    }
+    mpi_rec_t *r = mpi_rec(wk->out, wk->n_out++);
+    r->h = h;
+    r->parent = se->level.refs[key_parent(key)];
+    memcpy(r->c, p, (1 + sk->n_boxes) * sizeof(cidx_t));
+}
+
+// Expande a parte deste processo na camada atual e troca os sucessores com os outros processos
+// Fase 1: as threads expandem a camada local para os buffers de envio. Fase 2: os registros são
+// agrupados por processo dono e trocados com MPI_Alltoallv. Fase 3: cada registro recebido é
+// procurado na tabela local e, entre os que geram o mesmo estado novo, o primeiro na ordem de
+// recebimento é o dono (a disputa é a de queue_move); os donos formam a próxima camada local.
+// Retorna o estado final encontrado neste processo, ou 0
+sidx_t mpi_expand()
+{
+    frontier_t *level = &sk->fwd.level;
+    assert(sk->fwd.depth + 1 < (1 << (64 - KEY_DEPTH_SHIFT)));
+    for (int t = 0; t < sk->n_workers; t++)
+        sk->workers[t].n_out = 0;
+
+#pragma omp parallel copyin(sk)
+    {
+        worker_t *wk = &sk->workers[omp_get_thread_num()];
+#pragma omp for schedule(dynamic, CHUNK)
+        for (size_t i = 0; i < level->n; i++)
+        {
+            if (sk->push_mode)
+                do_push(&sk->fwd, i, wk);
+            else
+                do_move(&sk->fwd, i, wk);
+        }
+    }
+
+    // Agrupa os registros por processo dono, na ordem das threads
+    int *send_n = calloc(n_ranks, sizeof(int)), *send_off = malloc(n_ranks * sizeof(int));
+    int *recv_n = malloc(n_ranks * sizeof(int)), *recv_off = malloc(n_ranks * sizeof(int));
+    assert(send_n && send_off && recv_n && recv_off);
+    size_t n_send = 0, n_recv = 0;
+    for (int t = 0; t < sk->n_workers; t++)
+        for (size_t k = 0; k < sk->workers[t].n_out; k++)
+            send_n[rank_of(mpi_rec(sk->workers[t].out, k)->h)]++;
+    for (int r = 0; r < n_ranks; r++)
+    {
+        send_off[r] = n_send;
+        n_send += send_n[r];
+    }
+    assert(n_send <= INT32_MAX); // Contagens e deslocamentos do MPI são int
+    uint8_t *send = malloc((n_send + 1) * sk->mpi_rec_size);
+    assert(send);
+    memcpy(recv_off, send_off, n_ranks * sizeof(int)); // Posição de escrita de cada dono
+    for (int t = 0; t < sk->n_workers; t++)
+        for (size_t k = 0; k < sk->workers[t].n_out; k++)
+        {
+            const mpi_rec_t *r = mpi_rec(sk->workers[t].out, k);
+            memcpy(mpi_rec(send, recv_off[rank_of(r->h)]++), r, sk->mpi_rec_size);
+        }
+
+    MPI_Alltoall(send_n, 1, MPI_INT, recv_n, 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < n_ranks; r++)
+    {
+        recv_off[r] = n_recv;
+        n_recv += recv_n[r];
+    }
+    assert(n_recv <= INT32_MAX);
+    uint8_t *recv = malloc((n_recv + 1) * sk->mpi_rec_size);
+    assert(recv);
+    MPI_Alltoallv(send, send_n, send_off, sk->mpi_rec_type, recv, recv_n, recv_off, sk->mpi_rec_type, MPI_COMM_WORLD);
+    free(send);
+
+    // Insere os recebidos na tabela; refs[k] fica com o estado do registro k se ele é desta camada
+    reserve_table(&sk->fwd.table, n_recv);
+    sidx_t *refs = malloc((n_recv + 1) * sizeof(sidx_t));
+    assert(refs);
+    const uint64_t layer_key = make_key(sk->fwd.depth + 1, 0, 0);
+#pragma omp parallel for schedule(dynamic, CHUNK) copyin(sk)
+    for (size_t k = 0; k < n_recv; k++)
+    {
+        const mpi_rec_t *r = mpi_rec(recv, k);
+        const uint64_t key = layer_key | k;
+        refs[k] = 0;
+        sidx_t s = lookup(&sk->fwd.table, r->c, r->h);
+        if (!s)
+        {
+            s = newstate(0);
+            state_t *st = state_at(s);
+            memcpy(st->c, r->c, (1 + sk->n_boxes) * sizeof(cidx_t));
+            st->owner = key;
+            sidx_t f;
+            if (insert_if_absent(&sk->fwd.table, s, r->h, &f))
+            {
+                refs[k] = s;
+                continue;
+            }
+            unnewstate(s);
+            s = f;
+        }
+        TELE(duplicates, 1);
+        uint64_t *owner = &state_at(s)->owner;
+        uint64_t cur = __atomic_load_n(owner, __ATOMIC_RELAXED);
+        if ((cur >> KEY_DEPTH_SHIFT) != (key >> KEY_DEPTH_SHIFT))
+            continue; // Já visitado numa camada anterior
+        while (key < cur && !__atomic_compare_exchange_n(owner, &cur, key, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+        refs[k] = s;
+    }
+
+    size_t kept = 0;
+#pragma omp parallel for reduction(+ : kept) copyin(sk)
+    for (size_t k = 0; k < n_recv; k++)
+        kept += refs[k] && state_at(refs[k])->owner == (layer_key | k);
+
+    // Copia os donos para a próxima camada. Depois da cópia, owner dá lugar ao processo do pai:
+    // a profundidade 0 nos bits altos faz os repetidos das próximas camadas o tratarem como antigo
+    frontier_t next;
+    alloc_frontier(&next, kept);
+    sidx_t found = 0;
+    for (size_t k = 0, j = 0, src = 0; k < n_recv; k++)
+    {
+        while (k >= (size_t)recv_off[src] + recv_n[src])
+            src++;
+        if (!refs[k])
+            continue;
+        state_t *st = state_at(refs[k]);
+        if (st->owner != (layer_key | k))
+            continue;
+        const mpi_rec_t *r = mpi_rec(recv, k);
+        st->prev = r->parent;
+        st->from_rank = src;
+        memcpy(row(&next, j), st->c, (1 + sk->n_boxes) * sizeof(cidx_t));
+        next.hashes[j] = r->h;
+        next.refs[j] = refs[k];
+        next.parent[j] = 0; // O pai fica em outro processo (prev e from_rank)
+        if (!found && success(st->c))
+            found = refs[k];
+        j++;
+    }
+
+    free(refs);
+    free(recv);
+    free(send_n);
+    free(send_off);
+    free(recv_n);
+    free(recv_off);
+    free_frontier(level);
+    *level = next;
+    sk->fwd.table.filled += next.n;
+    sk->fwd.depth++;
+    return found;
+}
+
+// Refaz o caminho até o estado final goal, que está no processo holder, e o deixa em mpi_path
+// (em todos os processos). O dono de cada estado difunde as posições, o pai e o processo do pai
+void mpi_rebuild(int holder, sidx_t goal)
+{
+    const size_t row_cells = 1 + sk->n_boxes;
+    int cap = 64, n = 0;
+    cidx_t *rows = malloc(cap * row_cells * sizeof(cidx_t));
+    assert(rows);
+    for (sidx_t cur = goal;;)
+    {
+        if (n == cap)
+        {
+            rows = realloc(rows, (cap *= 2) * row_cells * sizeof(cidx_t));
+            assert(rows);
+        }
+        cidx_t *r = rows + n++ * row_cells;
+        uint32_t link[2]; // pai e processo do pai
+        if (mpi_rank == holder)
+        {
+            const state_t *st = state_at(cur);
+            memcpy(r, st->c, row_cells * sizeof(cidx_t));
+            link[0] = st->prev;
+            link[1] = st->from_rank;
+        }
+        MPI_Bcast(r, row_cells, MPI_UINT16_T, holder, MPI_COMM_WORLD);
+        MPI_Bcast(link, 2, MPI_UINT32_T, holder, MPI_COMM_WORLD);
+        if (!link[0]) // Chegou ao estado inicial
+            break;
+        cur = link[0];
+        holder = link[1];
+    }
+
+    // Inverte para ficar do início ao final
+    sk->mpi_path = malloc(n * row_cells * sizeof(cidx_t));
+    assert(sk->mpi_path);
+    for (int k = 0; k < n; k++)
+        memcpy(sk->mpi_path + k * row_cells, rows + (n - 1 - k) * row_cells, row_cells * sizeof(cidx_t));
+    sk->mpi_len = n;
+    free(rows);
+}
+
+// Busca em largura distribuída a partir do estado inicial s, de hash hs; deixa a solução em mpi_path
+void mpi_bfs(sidx_t s, hash_t hs)
+{
+    sk->mpi_rec_size = (offsetof(mpi_rec_t, c) + (1 + sk->n_boxes) * sizeof(cidx_t) + 7) / 8 * 8;
+    MPI_Type_contiguous(sk->mpi_rec_size, MPI_BYTE, &sk->mpi_rec_type);
+    MPI_Type_commit(&sk->mpi_rec_type);
+
+    // A primeira camada tem só o estado inicial, no processo dono dele
+    const int home = rank_of(hs);
+    reserve_table(&sk->fwd.table, 1);
+    sidx_t goal = 0;
+    if (mpi_rank == home)
+    {
+        sidx_t f;
+        state_at(s)->owner = make_key(0, 0, 0);
+        insert_if_absent(&sk->fwd.table, s, hs, &f);
+        sk->fwd.table.filled = 1;
+        alloc_frontier(&sk->fwd.level, 1);
+        memcpy(row(&sk->fwd.level, 0), state_at(s)->c, (1 + sk->n_boxes) * sizeof(cidx_t));
+        sk->fwd.level.hashes[0] = hs;
+        sk->fwd.level.refs[0] = s;
+        sk->fwd.level.parent[0] = 0;
+        if (success(state_at(s)->c))
+            goal = s;
+    }
+    else
+        alloc_frontier(&sk->fwd.level, 0);
+
+    // Cada camada termina com todos os processos sabendo se alguém achou o final ou se ela ficou vazia
+    int found = goal ? mpi_rank : n_ranks;
+    MPI_Allreduce(MPI_IN_PLACE, &found, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    while (found == n_ranks)
+    {
+        unsigned long long n = sk->fwd.level.n;
+        MPI_Allreduce(MPI_IN_PLACE, &n, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        if (!n)
+            break; // Sem solução
+        goal = mpi_expand();
+        found = goal ? mpi_rank : n_ranks;
+        MPI_Allreduce(MPI_IN_PLACE, &found, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    }
+    if (found < n_ranks)
+        mpi_rebuild(found, goal);
+
+    unsigned long long filled = sk->fwd.table.filled;
+    sk->mpi_filled = malloc(n_ranks * sizeof(unsigned long long));
+    assert(sk->mpi_filled);
+    MPI_Allgather(&filled, 1, MPI_UNSIGNED_LONG_LONG, sk->mpi_filled, 1, MPI_UNSIGNED_LONG_LONG, MPI_COMM_WORLD);
+    sk->mpi_visited = 0;
+    for (int r = 0; r < n_ranks; r++)
+        sk->mpi_visited += sk->mpi_filled[r];
+    MPI_Type_free(&sk->mpi_rec_type);
+}
+
+// Encerra o MPI na saída do programa (registrada com atexit em main)
+static void mpi_finish()
+{
+    MPI_Finalize();
+}
+#endif
+
+/*----------- Busca em memória externa -----------*/
+
+/* Busca em largura com detecção atrasada de repetidos (-e dir), para níveis que não cabem na
+   memória. Nenhuma tabela de hash é usada: cada camada fica num arquivo de registros (posições
+   do jogador e das caixas, mais um byte com o movimento que gerou o estado), ordenado pelas
+   posições. A expansão lê a camada e cada thread acumula sucessores num buffer; quando o buffer
+   enche (o orçamento -m é dividido entre as threads), ele é ordenado, sem repetidos, e gravado
+   como uma corrida. No fim da camada, as corridas são intercaladas (k-way merge) junto com o
+   arquivo ordenado de todos os estados já visitados: o que não estava lá forma a camada seguinte
+   e entra no novo arquivo de visitados. Os movimentos do jogo não são reversíveis (empurrões), e
+   mesmo sem empurrar o jogador volta a um estado depois de 4 passos, então comparar só com as
+   duas últimas camadas deixaria repetidos passarem; o arquivo de visitados torna a comparação
+   exata com E/S sequencial. O caminho é refeito de trás para frente: o movimento guardado no
+   registro diz como desfazer o passo, e o pai é procurado por busca binária no arquivo da camada
+   anterior. Só funciona na busca por passos (sem -p, -a ou -b). */
+
+// Buffer de sucessores de uma thread
+typedef struct
+{
+    uint8_t *recs;
+    size_t n, cap; // registros em recs e capacidade
+} ext_buf_t;
+
+// Leitor sequencial de um arquivo de registros
+typedef struct
+{
+    FILE *f;
+    uint8_t *rec; // registro atual (válido enquanto ok)
+    bool ok;
+} ext_reader_t;
+
+static int rec_cmp(const void *a, const void *b)
+{
+    return memcmp(a, b, sk->key_size);
+}
+
+// Nome de um arquivo de trabalho (o pid e o número do contexto separam buscas simultâneas no mesmo
+// diretório, de processos diferentes ou de contextos diferentes da biblioteca)
+char *ext_path(const char *kind, int a, int b)
+{
+    char *path = malloc(strlen(sk->ext_dir) + 80);
+    assert(path);
+    sprintf(path, "%s/sokoban-%d-%u-%s-%d-%d", sk->ext_dir, (int)getpid(), sk->id, kind, a, b);
+    return path;
+}
+
+/* Um erro de leitura ou gravação marca failed (só o primeiro é impresso) em vez de encerrar o
+   processo: as funções abaixo aceitam o arquivo NULL de um ext_open que falhou, e ext_bfs para na
+   próxima camada e apaga os arquivos de trabalho. */
+
+// Marca a falha da busca em disco e imprime o erro, se for o primeiro
+void ext_fail(const char *what)
+{
+    if (!__atomic_exchange_n(&sk->failed, true, __ATOMIC_RELAXED))
+        perror(what);
+}
+
+FILE *ext_open(const char *path, const char *mode)
+{
+    FILE *f = fopen(path, mode);
+    if (!f)
+    {
+        ext_fail(path);
+        return NULL;
+    }
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+    return f;
+}
+
+void ext_write(FILE *f, const void *rec)
+{
+    if (f && fwrite(rec, sk->rec_size, 1, f) != 1)
+        ext_fail("Gravação de registro");
+}
+
+// Fecha f; o fclose grava o que restou no buffer, então também pode falhar
+void ext_close(FILE *f)
+{
+    if (f && fclose(f))
+        ext_fail("Gravação de registro");
+}
+
+void ext_next(ext_reader_t *r)
+{
+    r->ok = r->f && fread(r->rec, sk->rec_size, 1, r->f) == 1;
+}
+
+// Ordena o buffer, tira os repetidos e o grava como uma corrida da camada `depth`
+void ext_flush(ext_buf_t *b, int depth)
+{
+    if (!b->n)
+        return;
+    qsort(b->recs, b->n, sk->rec_size, rec_cmp);
+
+    char *path;
+#pragma omp critical(corridas)
+    {
+        if (sk->n_ext_runs == sk->cap_ext_runs)
+        {
+            sk->cap_ext_runs = sk->cap_ext_runs ? sk->cap_ext_runs * 2 : 64;
+            sk->ext_runs = realloc(sk->ext_runs, sk->cap_ext_runs * sizeof(char *));
+            assert(sk->ext_runs);
+        }
+        path = ext_path("corrida", depth, sk->n_ext_runs);
+        sk->ext_runs[sk->n_ext_runs++] = path;
+    }
+    FILE *f = ext_open(path, "wb");
+    for (size_t i = 0; i < b->n; i++)
+        if (!i || rec_cmp(b->recs + (i - 1) * sk->rec_size, b->recs + i * sk->rec_size))
+            ext_write(f, b->recs + i * sk->rec_size);
+    ext_close(f);
+    b->n = 0;
+}
+
+// Move o jogador do estado c na direção d (índice de offsets) e escreve o sucessor em p
+// Retorna o byte de movimento (d, mais 4 se empurrou uma caixa) ou -1 se o movimento não vale
+static int ext_move(const cidx_t *c, int d, cidx_t *p, worker_t *wk)
+{
+    const int c1 = c[0] + sk->offsets[d];
+    if (c1 < 0 || c1 >= sk->w * sk->h || sk->board[c1] == wall)
+        return -1;
+    memcpy(p, c, sk->key_size);
+    p[0] = c1;
+
+    int at_box = 0;
+    for (int i = 1; i <= sk->n_boxes && !at_box; i++)
+        if (c[i] == c1)
+            at_box = i;
+    if (!at_box)
+        return d;
+
+    const int c2 = c1 + sk->offsets[d];
+    if (sk->board[c2] == wall || !sk->live[c2])
+        return -1;
+    for (int i = 1; i <= sk->n_boxes; i++)
+        if (c[i] == c2)
+            return -1;
+
+    // Troca a caixa de lugar mantendo o vetor ordenado (um deslocamento para um dos lados)
+    int i = at_box;
+    for (; i > 1 && p[i - 1] > c2; i--)
+        p[i] = p[i - 1];
+    for (; i < sk->n_boxes && p[i + 1] < c2; i++)
+        p[i] = p[i + 1];
+    p[i] = c2;
+
+    if (sk->deadlock_checks)
+    {
+        for (int k = 1; k <= sk->n_boxes; k++)
+            wk->occ[p[k]] = 1;
+        const bool dead = deadlocked(p, c1, c2, wk);
+        for (int k = 1; k <= sk->n_boxes; k++)
+            wk->occ[p[k]] = 0;
+        if (dead)
+            return -1;
+    }
+    return d | 4;
+}
+
+// Desfaz o movimento m que levou ao estado c, escrevendo o estado anterior em p
+static void ext_unmove(const cidx_t *c, int m, cidx_t *p)
+{
+    const int d = m & 3;
+    memcpy(p, c, sk->key_size);
+    p[0] = c[0] - sk->offsets[d];
+    if (!(m & 4))
+        return;
+
+    const int from = c[0] + sk->offsets[d], to = c[0]; // A caixa volta para onde o jogador está
+    int i = 1;
+    while (p[i] != from)
+        i++;
+    for (; i > 1 && p[i - 1] > to; i--)
+        p[i] = p[i - 1];
+    for (; i < sk->n_boxes && p[i + 1] < to; i++)
+        p[i] = p[i + 1];
+    p[i] = to;
+}
+
+// Mapeia um arquivo de registros para leitura; retorna o número de registros (0 se falhar)
+size_t ext_map(const char *path, const uint8_t **data)
+{
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    *data = NULL;
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        ext_fail(path);
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    *data = st.st_size ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (*data == MAP_FAILED)
+    {
+        ext_fail(path);
+        *data = NULL;
+        return 0;
+    }
+    return st.st_size / sk->rec_size;
+}
+
+// Expande a camada `depth`, gravando os sucessores em corridas; retorna o registro de um estado
+// final se algum sucessor resolver o jogo (alocado, ou NULL)
+uint8_t *ext_expand(int depth)
+{
+    char *path = ext_path("camada", depth, 0);
+    const uint8_t *layer;
+    const size_t n = ext_map(path, &layer);
+    free(path);
+    uint8_t *goal = NULL;
+    sk->n_ext_runs = 0;
+
+#pragma omp parallel copyin(sk)
+    {
+        worker_t *wk = &sk->workers[omp_get_thread_num()];
+        ext_buf_t b = {.cap = sk->ext_budget / sk->n_workers / sk->rec_size};
+        if (b.cap < 1024)
+            b.cap = 1024;
+        b.recs = malloc(b.cap * sk->rec_size);
+        cidx_t *c = malloc(sk->key_size), *p = malloc(sk->rec_size);
+        assert(b.recs && c && p);
+
+#pragma omp for schedule(dynamic, CHUNK)
+        for (size_t i = 0; i < n; i++)
+        {
+            if (__atomic_load_n(&goal, __ATOMIC_RELAXED))
+                continue; // Já há uma solução nesta profundidade
+            memcpy(c, layer + i * sk->rec_size, sk->key_size);
+            for (int d = 0; d < 4; d++)
+            {
+                const int m = ext_move(c, d, p, wk);
+                if (m < 0)
+                    continue;
+                uint8_t *r = b.recs + b.n++ * sk->rec_size;
+                memcpy(r, p, sk->key_size);
+                r[sk->key_size] = m;
+                if (success(p))
+                {
+#pragma omp critical(solucao)
+                    if (!goal)
+                    {
+                        uint8_t *g = malloc(sk->rec_size);
+                        assert(g);
+                        memcpy(g, r, sk->rec_size);
+                        __atomic_store_n(&goal, g, __ATOMIC_RELAXED);
+                    }
+                }
+                if (b.n == b.cap)
+                    ext_flush(&b, depth);
+            }
+        }
+        ext_flush(&b, depth);
+        free(b.recs);
+        free(c);
+        free(p);
+    }
+
+    if (layer)
+        munmap((void *)layer, n * sk->rec_size);
+    return goal;
+}
+
+// Intercala as corridas da camada `depth` com os visitados, gravando a camada depth + 1 e o novo
+// arquivo de visitados; retorna o tamanho da nova camada
+size_t ext_merge(int depth)
+{
+    const size_t k = sk->n_ext_runs;
+    ext_reader_t *runs = malloc((k + 1) * sizeof(ext_reader_t));
+    size_t *heap = malloc(k * sizeof(size_t)), n_heap = 0;
+    uint8_t *last = malloc(sk->rec_size);
+    assert(runs && heap && last);
+
+    // Heap de corridas ordenado pelo registro atual de cada uma
+#define RUN_LESS(a, b) (memcmp(runs[a].rec, runs[b].rec, sk->key_size) < 0)
+    for (size_t i = 0; i <= k; i++)
+    {
+        char *path = i < k ? sk->ext_runs[i] : ext_path("visitados", depth, 0);
+        runs[i].f = ext_open(path, "rb");
+        runs[i].rec = malloc(sk->rec_size);
+        assert(runs[i].rec);
+        ext_next(&runs[i]);
+        if (i == k)
+            free(path);
+        if (i == k || !runs[i].ok)
+            continue;
+        size_t j = n_heap++;
+        for (; j && RUN_LESS(i, heap[(j - 1) / 2]); j = (j - 1) / 2)
+            heap[j] = heap[(j - 1) / 2];
+        heap[j] = i;
+    }
+
+    ext_reader_t *vis = &runs[k];
+    char *path = ext_path("camada", depth + 1, 0);
+    FILE *out = ext_open(path, "wb");
+    free(path);
+    path = ext_path("visitados", depth + 1, 0);
+    FILE *vout = ext_open(path, "wb");
+    free(path);
+
+    size_t added = 0;
+    bool have_last = false;
+    while (n_heap)
+    {
+        const size_t top = heap[0];
+        const bool repeated = have_last && !memcmp(last, runs[top].rec, sk->key_size);
+        if (!repeated)
+        {
+            memcpy(last, runs[top].rec, sk->rec_size);
+            have_last = true;
+
+            // Copia os visitados menores e verifica se o sucessor já estava entre eles
+            while (vis->ok && memcmp(vis->rec, last, sk->key_size) < 0)
+                ext_write(vout, vis->rec), ext_next(vis);
+            if (!vis->ok || memcmp(vis->rec, last, sk->key_size))
+            {
+                ext_write(out, last);
+                ext_write(vout, last);
+                added++;
+            }
+        }
+
+        // Avança a corrida do topo e a recoloca no heap
+        ext_next(&runs[top]);
+        const size_t x = runs[top].ok ? top : heap[--n_heap];
+        size_t i = 0;
+        for (;;)
+        {
+            size_t c = 2 * i + 1;
+            if (c >= n_heap)
+                break;
+            if (c + 1 < n_heap && RUN_LESS(heap[c + 1], heap[c]))
+                c++;
+            if (!RUN_LESS(heap[c], x))
+                break;
+            heap[i] = heap[c];
+            i = c;
+        }
+        if (n_heap)
+            heap[i] = x;
+    }
+#undef RUN_LESS
+    while (vis->ok)
+        ext_write(vout, vis->rec), ext_next(vis);
+
+    ext_close(out);
+    ext_close(vout);
+    for (size_t i = 0; i <= k; i++)
+    {
+        if (runs[i].f)
+            fclose(runs[i].f);
+        free(runs[i].rec);
+        if (i < k)
+        {
+            unlink(sk->ext_runs[i]);
+            free(sk->ext_runs[i]);
+        }
+    }
+    sk->n_ext_runs = 0;
+    path = ext_path("visitados", depth, 0);
+    unlink(path);
+    free(path);
+    free(runs);
+    free(heap);
+    free(last);
+    return added;
+}
+
+// Refaz o caminho do registro final (na camada `depth`) até o início e o guarda em ext_solution
+void ext_rebuild(const uint8_t *goal, int depth)
+{
+    sk->ext_solution = malloc(depth + 2);
+    cidx_t *c = malloc(sk->key_size), *p = malloc(sk->key_size);
+    assert(sk->ext_solution && c && p);
+    sk->ext_solution[depth] = '\n';
+    sk->ext_solution[depth + 1] = '\0';
+
+    memcpy(c, goal, sk->key_size);
+    int m = goal[sk->key_size];
+    for (int k = depth; k > 0; k--)
+    {
+        sk->ext_solution[k - 1] = (m & 4 ? "RLUD" : "rlud")[m & 3];
+        ext_unmove(c, m, p);
+        if (k == 1)
+            break;
+
+        // Procura o pai na camada anterior para saber o movimento que o gerou
+        char *path = ext_path("camada", k - 1, 0);
+        const uint8_t *layer;
+        const size_t n = ext_map(path, &layer);
+        free(path);
+        if (sk->failed)
+            break;
+        const uint8_t *r = bsearch(p, layer, n, sk->rec_size, rec_cmp);
+        assert(r);
+        m = r[sk->key_size];
+        memcpy(c, p, sk->key_size);
+        munmap((void *)layer, n * sk->rec_size);
+    }
+    free(c);
+    free(p);
+    if (sk->failed) // Caminho incompleto
+    {
+        free(sk->ext_solution);
+        sk->ext_solution = NULL;
+    }
+}
+
+// Busca em largura em disco a partir do estado inicial; deixa a solução em ext_solution, ou marca
+// failed se um arquivo de trabalho não puder ser lido ou gravado
+void ext_bfs(const state_t *s)
+{
+    sk->key_size = (1 + sk->n_boxes) * sizeof(cidx_t);
+    sk->rec_size = sk->key_size + 1;
+    uint8_t *rec = malloc(sk->rec_size);
+    assert(rec);
+    memcpy(rec, s->c, sk->key_size);
+    rec[sk->key_size] = 0;
+
+    // A camada 0 e os visitados começam só com o estado inicial
+    for (int i = 0; i < 2; i++)
+    {
+        char *path = ext_path(i ? "visitados" : "camada", 0, 0);
+        FILE *f = ext_open(path, "wb");
+        ext_write(f, rec);
+        ext_close(f);
+        free(path);
+    }
+    free(rec);
+    sk->ext_visited = 1;
+
+    int depth = 0;
+    if (success(s->c))
+        sk->ext_solution = strdup("\n");
+    while (!sk->ext_solution && !sk->failed)
+    {
+        uint8_t *goal = ext_expand(depth);
+        if (goal)
+        {
+            ext_rebuild(goal, depth + 1);
+            free(goal);
+            break;
+        }
+        if (sk->failed)
+            break;
+        const size_t n = ext_merge(depth);
+        sk->ext_visited += n;
+        depth++;
+        if (!n)
+            break; // Sem solução
+    }
+
+    // Apaga os arquivos de trabalho
+    for (int k = 0; k <= depth + 1; k++)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            char *path = ext_path(i ? "visitados" : "camada", k, 0);
+            unlink(path);
+            free(path);
+        }
+    }
+    for (size_t i = 0; i < sk->n_ext_runs; i++)
+    {
+        unlink(sk->ext_runs[i]);
+        free(sk->ext_runs[i]);
+    }
+    sk->n_ext_runs = 0;
+    free(sk->ext_runs);
+    sk->ext_runs = NULL;
+}
+
+/*----------- Bancos de padrões -----------*/
+
+/* Com -g N (A* e IDA*), a heurística também consulta um banco de padrões: para cada conjunto de
+   N casas vivas e cada casa do jogador, o número mínimo de empurrões para levar N caixas dessas
+   casas a N metas distintas, ignorando as outras caixas. O banco é construído no início por uma
+   BFS reversa sobre o tabuleiro estático, com puxadas a partir de todas as combinações de N metas
+   e de todas as regiões do jogador nelas. Cada camada é repartida entre as threads, e um estado
+   (caixas e região do jogador, pela casa canônica) é reivindicado por compare-and-swap na tabela.
+   A tabela tem um byte por entrada (empurrões + 1; 0 = inalcançável), indexada pelo número
+   combinatório do conjunto de casas vivas e pela casa do jogador entre as de chão; todas as casas
+   da região recebem o valor, então a consulta usa a posição do jogador como está no estado. */
+
+#define PDB_MAX 254 // maior distância guardada; as maiores ficam em PDB_MAX, o que mantém o h admissível
+
+// Linhas (jogador e pdb_k caixas) de uma camada da BFS reversa
+typedef struct
+{
+    cidx_t *rows;
+    size_t n, cap;
+} pdb_list_t;
+
+// Calcula os índices das casas vivas e de chão e o tamanho do banco de -g (precisa de live)
+// Retorna false se o banco passar da metade do limite de -M
+bool pdb_index()
+{
+    sk->pdb_live_idx = malloc(sk->w * sk->h * sizeof(int));
+    sk->pdb_floor_idx = malloc(sk->w * sk->h * sizeof(int));
+    assert(sk->pdb_live_idx && sk->pdb_floor_idx);
+    sk->pdb_live = sk->pdb_floor = 0;
+    for (int i = 0; i < sk->w * sk->h; i++)
+    {
+        sk->pdb_live_idx[i] = sk->live[i] ? sk->pdb_live++ : -1;
+        sk->pdb_floor_idx[i] = sk->board[i] != wall ? sk->pdb_floor++ : -1;
+    }
+
+    const int r = sk->pdb_k + 1;
+    sk->pdb_binom = malloc((size_t)(sk->pdb_live + 1) * r * sizeof(size_t));
+    assert(sk->pdb_binom);
+    for (int n = 0; n <= sk->pdb_live; n++)
+        for (int k = 0; k <= sk->pdb_k; k++)
+            sk->pdb_binom[n * r + k] = !k ? 1 : !n ? 0 : sk->pdb_binom[(n - 1) * r + k - 1] + sk->pdb_binom[(n - 1) * r + k];
+
+    sk->pdb_bytes = sk->pdb_binom[sk->pdb_live * r + sk->pdb_k] * sk->pdb_floor;
+    return !sk->mem_limit || sk->pdb_bytes <= sk->mem_limit / 2;
+}
+
+// Índice na tabela do conjunto de casas vivas boxes[0] < ... < boxes[pdb_k - 1]
+static inline size_t pdb_set(const cidx_t *boxes)
+{
+    size_t set = 0;
+    for (int i = 0; i < sk->pdb_k; i++)
+        set += sk->pdb_binom[(size_t)sk->pdb_live_idx[boxes[i]] * (sk->pdb_k + 1) + i + 1];
+    return set;
+}
+
+// Acrescenta uma linha ao fim de list
+static void pdb_append(pdb_list_t *list, const cidx_t *row)
+{
+    const int stride = sk->pdb_k + 1;
+    if (list->n == list->cap)
+    {
+        list->cap = list->cap ? list->cap * 2 : 1024;
+        list->rows = realloc(list->rows, list->cap * stride * sizeof(cidx_t));
+        assert(list->rows);
+    }
+    memcpy(list->rows + list->n++ * stride, row, stride * sizeof(cidx_t));
+}
+
+// Registra a configuração row (jogador em row[0], caixas ordenadas em row[1..] e marcadas em
+// occ) a dist empurrões das metas, se ela ainda não foi alcançada: toda a região do jogador
+// recebe o valor, e a linha vai para list com o jogador na casa canônica
+static void pdb_visit(cidx_t *row, int dist, const uint8_t *occ, worker_t *wk, pdb_list_t *list)
+{
+    uint8_t *e = sk->pdb + pdb_set(row + 1) * sk->pdb_floor;
+    if (__atomic_load_n(&e[sk->pdb_floor_idx[row[0]]], __ATOMIC_RELAXED))
+        return;
+    row[0] = flood(row[0], occ, wk->seen2, wk->queue);
+
+    uint8_t none = 0;
+    const uint8_t v = (dist < PDB_MAX ? dist : PDB_MAX) + 1;
+    if (!__atomic_compare_exchange_n(&e[sk->pdb_floor_idx[row[0]]], &none, v, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return;
+    for (int i = 0; i < sk->w * sk->h; i++) // As regiões de um conjunto são disjuntas: só esta thread escreve nelas
+        if (wk->seen2[i])
+            __atomic_store_n(&e[sk->pdb_floor_idx[i]], v, __ATOMIC_RELAXED);
+    pdb_append(list, row);
+}
+
+// Gera as puxadas da configuração row (jogador na casa canônica), que está a dist empurrões das metas
+static void pdb_expand(const cidx_t *row, int dist, worker_t *wk, pdb_list_t *list)
+{
+    cidx_t kid[sk->pdb_k + 1];
+    for (int k = 1; k <= sk->pdb_k; k++)
+        wk->occ[row[k]] = 1;
+    flood(row[0], wk->occ, wk->seen, wk->queue);
+
+    for (int k = 1; k <= sk->pdb_k; k++)
+        for (int d = 0; d < 4; d++)
+        {
+            // A caixa em b vem para at, onde estava o jogador, e o jogador recua para back
+            const int b = row[k], at = b - sk->offsets[d], back = at - sk->offsets[d];
+            if (!wk->seen[at] || !sk->live[at] || back < 0 || back >= sk->w * sk->h || sk->board[back] == wall || wk->occ[back])
+                continue;
+
+            // Copia as outras caixas e insere at na posição certa
+            int j = 1;
+            kid[0] = back;
+            for (int i = 1; i <= sk->pdb_k; i++)
+                if (i != k)
+                    kid[j++] = row[i];
+            for (j = sk->pdb_k; j > 1 && kid[j - 1] > at; j--)
+                kid[j] = kid[j - 1];
+            kid[j] = at;
+
+            wk->occ[b] = 0, wk->occ[at] = 1;
+            pdb_visit(kid, dist + 1, wk->occ, wk, list);
+            wk->occ[at] = 0, wk->occ[b] = 1;
+        }
+
+    for (int k = 1; k <= sk->pdb_k; k++)
+        wk->occ[row[k]] = 0;
+}
+
+// Junta as listas das threads em cur (esvaziando-as); retorna a quantidade de linhas
+static size_t pdb_gather(pdb_list_t *cur, pdb_list_t *lists)
+{
+    const size_t row_bytes = (sk->pdb_k + 1) * sizeof(cidx_t);
+    cur->n = 0;
+    for (int t = 0; t < sk->n_workers; t++)
+    {
+        if (!lists[t].n) // Thread sem sucessores (rows ainda pode ser NULL)
+            continue;
+        if (cur->n + lists[t].n > cur->cap)
+        {
+            cur->cap = cur->n + lists[t].n;
+            cur->rows = realloc(cur->rows, cur->cap * row_bytes);
+            assert(cur->rows);
+        }
+        memcpy((uint8_t *)cur->rows + cur->n * row_bytes, lists[t].rows, lists[t].n * row_bytes);
+        cur->n += lists[t].n;
+        lists[t].n = 0;
+    }
+    return cur->n;
+}
+
+// Constrói o banco de -g em pdb (precisa de pdb_index, live e goal_cells), com todas as threads
+void init_pdb()
+{
+    const int stride = sk->pdb_k + 1;
+    sk->pdb = table_alloc(sk->pdb_bytes);
+    assert(sk->pdb);
+    pdb_list_t cur = {0}, *next = calloc(sk->n_workers, sizeof(pdb_list_t));
+    assert(next);
+
+    // Ponto de partida: as caixas em cada combinação de pdb_k metas (em ordem, como goal_cells)
+    int pick[sk->pdb_k];
+    cidx_t row[stride];
+    for (int i = 0; i < sk->pdb_k; i++)
+        pick[i] = i;
+    while (sk->pdb_k <= sk->n_goals)
+    {
+        row[0] = 0;
+        for (int i = 0; i < sk->pdb_k; i++)
+            row[i + 1] = sk->goal_cells[pick[i]];
+        pdb_append(&cur, row);
+
+        int i = sk->pdb_k - 1;
+        while (i >= 0 && pick[i] == sk->n_goals - sk->pdb_k + i)
+            i--;
+        if (i < 0)
+            break;
+        pick[i]++;
+        for (int j = i + 1; j < sk->pdb_k; j++)
+            pick[j] = pick[j - 1] + 1;
+    }
+
+    // Camada 0: cada região do jogador em cada combinação de metas
+#pragma omp parallel copyin(sk)
+    {
+        worker_t *wk = &sk->workers[omp_get_thread_num()];
+        cidx_t seed[stride];
+#pragma omp for schedule(dynamic, 16)
+        for (size_t s = 0; s < cur.n; s++)
+        {
+            memcpy(seed, cur.rows + s * stride, sizeof(seed));
+            for (int k = 1; k <= sk->pdb_k; k++)
+                wk->occ[seed[k]] = 1;
+            for (int p = 0; p < sk->w * sk->h; p++)
+                if (sk->board[p] != wall && !wk->occ[p])
+                {
+                    seed[0] = p;
+                    pdb_visit(seed, 0, wk->occ, wk, &next[omp_get_thread_num()]);
+                }
+            for (int k = 1; k <= sk->pdb_k; k++)
+                wk->occ[seed[k]] = 0;
+        }
+    }
+
+    // Camadas seguintes: as puxadas a partir da camada anterior
+    sk->pdb_states = 0;
+    for (int dist = 0; pdb_gather(&cur, next); dist++)
+    {
+        sk->pdb_states += cur.n;
+#pragma omp parallel for schedule(dynamic, 64) copyin(sk)
+        for (size_t i = 0; i < cur.n; i++)
+            pdb_expand(cur.rows + i * stride, dist, &sk->workers[omp_get_thread_num()], &next[omp_get_thread_num()]);
+    }
+
+    for (int t = 0; t < sk->n_workers; t++)
+        free(next[t].rows);
+    free(next);
+    free(cur.rows);
+}
+
+// Ordem dos grupos de pdb_cost: maior ganho primeiro
+static int by_gain(const void *a, const void *b)
+{
+    return *(const int *)b - *(const int *)a;
+}
+
+// Custo do banco de -g para as caixas de c: a distância de cada caixa até a meta mais próxima,
+// mais o ganho (valor do banco acima da soma dessas distâncias) de grupos disjuntos de pdb_k
+// caixas escolhidos gulosamente do maior ganho para o menor. Cada empurrão move uma caixa de um
+// grupo só, então a soma não passa dos empurrões que faltam, qualquer que seja a partição
+// Retorna INF_COST se alguma caixa ou algum grupo não chegar às metas
+int pdb_cost(const cidx_t *c, worker_t *wk)
+{
+    const int n = sk->n_boxes, stride = sk->pdb_k + 1;
+    int single[n + 1], total = 0;
+    bool used[n + 1];
+    for (int i = 1; i <= n; i++)
+    {
+        single[i] = INF_DIST;
+        for (int g = 0; g < sk->n_goals; g++)
+            if (sk->goal_dist[(size_t)g * sk->w * sk->h + c[i]] < single[i])
+                single[i] = sk->goal_dist[(size_t)g * sk->w * sk->h + c[i]];
+        if (single[i] == INF_DIST || sk->pdb_live_idx[c[i]] < 0)
+            return INF_COST;
+        total += single[i];
+        used[i] = false;
+    }
+    if (n < sk->pdb_k)
+        return total;
+
+    // Grupos com ganho positivo, cada um como ganho seguido dos índices das caixas
+    const uint8_t *col = sk->pdb + sk->pdb_floor_idx[c[0]];
+    int *cand = wk->pdb_cand, n_cand = 0, pick[sk->pdb_k];
+    cidx_t boxes[sk->pdb_k];
+    for (int i = 0; i < sk->pdb_k; i++)
+        pick[i] = i + 1;
+    for (;;)
+    {
+        int sum = 0;
+        for (int i = 0; i < sk->pdb_k; i++)
+            boxes[i] = c[pick[i]], sum += single[pick[i]];
+        const int v = col[pdb_set(boxes) * sk->pdb_floor];
+        if (!v)
+            return INF_COST;
+        if (v - 1 > sum)
+        {
+            cand[n_cand * stride] = v - 1 - sum;
+            memcpy(cand + n_cand++ * stride + 1, pick, sk->pdb_k * sizeof(int));
+        }
+
+        int i = sk->pdb_k - 1;
+        while (i >= 0 && pick[i] == n - sk->pdb_k + i + 1)
+            i--;
+        if (i < 0)
+            break;
+        pick[i]++;
+        for (int j = i + 1; j < sk->pdb_k; j++)
+            pick[j] = pick[j - 1] + 1;
+    }
+
+    qsort(cand, n_cand, stride * sizeof(int), by_gain);
+    for (int i = 0; i < n_cand; i++)
+    {
+        const int *g = cand + i * stride;
+        bool free_group = true;
+        for (int k = 1; k <= sk->pdb_k; k++)
+            free_group &= !used[g[k]];
+        if (!free_group)
+            continue;
+        for (int k = 1; k <= sk->pdb_k; k++)
+            used[g[k]] = true;
+        total += g[0];
+    }
+    return total;
+}
+
+/*----------- Busca A* -----------*/
+
+/* Busca de melhor escolha ordenada por f = g + h. O h é o custo mínimo de uma atribuição das
+   caixas a metas distintas (algoritmo húngaro), em que o custo de levar uma caixa até uma meta é
+   o número mínimo de empurrões ignorando as outras caixas, tirado de tabelas calculadas uma vez
+   depois de parse_board. Cada empurrão custa pelo menos um passo e muda h em no máximo 1, então
+   h é admissível e consistente: o primeiro estado final retirado da fila dá uma solução ótima
+   (em passos, ou em empurrões com -p). Com -g, h é o maior entre esse custo e o do banco de
+   padrões, que continua admissível mas pode não ser consistente; como um estado alcançado por um
+   caminho mais curto volta para a fila, a solução continua ótima. */
+
+// Custo mínimo de atribuir as caixas de c a metas distintas (algoritmo húngaro com potenciais, O(n² m))
+// Retorna INF_COST ou mais se alguma caixa não puder ser atribuída
+// Os vetores de trabalho (n_boxes linhas, n_goals colunas, indexados a partir de 1) são os de wk
+int matching_cost(const cidx_t *c, worker_t *wk)
+{
+    const int n = sk->n_boxes, m = sk->n_goals;
+    if (m < n) // Sobram caixas sem meta (e o laço abaixo não acharia coluna livre)
+        return INF_COST;
+    int *u = wk->hung, *v = u + n + 1, *p = v + m + 1, *way = p + m + 1, *minv = way + m + 1;
+    bool *used = wk->hung_used;
+    for (int j = 0; j <= m; j++)
+        v[j] = p[j] = 0;
+    for (int i = 0; i <= n; i++)
+        u[i] = 0;
+
+    for (int i = 1; i <= n; i++)
+    {
+        p[0] = i;
+        int j0 = 0;
+        for (int j = 0; j <= m; j++)
+            minv[j] = INT32_MAX, used[j] = false;
+        do
+        {
+            used[j0] = true;
+            const int i0 = p[j0];
+            int delta = INT32_MAX, j1 = 0;
+            for (int j = 1; j <= m; j++)
+            {
+                if (used[j])
+                    continue;
+                const int d = sk->goal_dist[(size_t)(j - 1) * sk->w * sk->h + c[i0]];
+                const int cur = (d == INF_DIST ? INF_COST : d) - u[i0] - v[j];
+                if (cur < minv[j])
+                    minv[j] = cur, way[j] = j0;
+                if (minv[j] < delta)
+                    delta = minv[j], j1 = j;
+            }
+            for (int j = 0; j <= m; j++)
+            {
+                if (used[j])
+                    u[p[j]] += delta, v[j] -= delta;
+                else
+                    minv[j] -= delta;
+            }
+            j0 = j1;
+        } while (p[j0]);
+        do
+        {
+            const int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+
+    int cost = 0;
+    for (int j = 1; j <= m; j++)
+        if (p[j])
+        {
+            const int d = sk->goal_dist[(size_t)(j - 1) * sk->w * sk->h + c[p[j]]];
+            cost += d == INF_DIST ? INF_COST : d;
+        }
+    return cost;
+}
+
+// Heurística do A* e do IDA*: o emparelhamento ou, com -g, o banco de padrões, o que for maior
+int heuristic(const cidx_t *c, worker_t *wk)
+{
+    const int m = matching_cost(c, wk);
+    if (!sk->pdb_k || m >= INF_COST)
+        return m;
+    const int p = pdb_cost(c, wk);
+    return p > m ? p : m;
+}
+
+// Ordem da fila: menor f primeiro e, empatado, maior g (mais perto do fim)
+static inline bool node_less(const node_t *a, const node_t *b)
+{
+    return a->f < b->f || (a->f == b->f && a->g > b->g);
+}
+
+void heap_push(node_t x)
+{
+    if (sk->heap_n == sk->heap_cap)
+    {
+        sk->heap_cap = sk->heap_cap ? sk->heap_cap * 2 : 1024;
+        sk->heap = realloc(sk->heap, sk->heap_cap * sizeof(node_t));
+        assert(sk->heap);
+    }
+    size_t i = sk->heap_n++;
+    while (i && node_less(&x, &sk->heap[(i - 1) / 2]))
+    {
+        sk->heap[i] = sk->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sk->heap[i] = x;
+}
+
+node_t heap_pop()
+{
+    const node_t top = sk->heap[0], x = sk->heap[--sk->heap_n];
+    size_t i = 0;
+    for (;;)
+    {
+        size_t k = 2 * i + 1;
+        if (k >= sk->heap_n)
+            break;
+        if (k + 1 < sk->heap_n && node_less(&sk->heap[k + 1], &sk->heap[k]))
+            k++;
+        if (!node_less(&sk->heap[k], &x))
+            break;
+        sk->heap[i] = sk->heap[k];
+        i = k;
+    }
+    sk->heap[i] = x;
+    return top;
+}
+
+// Coloca o sucessor de posições p (hash h, gerado a partir de parent) na fila com custo g; h < 0
+// pede o cálculo da heurística. Um estado já visitado só volta para a fila se o novo caminho for
+// mais curto; o registro na arena só é criado para estados novos
+void astar_queue(const cidx_t *p, hash_t h, sidx_t parent, uint32_t g, int hv)
+{
+    reserve_table(&sk->fwd.table, 1);
+    sidx_t s = lookup(&sk->fwd.table, p, h);
+    if (s)
+    {
+        state_t *old = state_at(s);
+        if (old->g <= g)
+            return;
+        old->g = g; // Caminho melhor: reabre o estado com o novo pai
+        old->prev = parent;
+        hv = -1;
+    }
+    else
+    {
+        sidx_t f;
+        s = newstate(parent);
+        memcpy(state_at(s)->c, p, (1 + sk->n_boxes) * sizeof(cidx_t));
+        state_at(s)->g = g;
+        insert_if_absent(&sk->fwd.table, s, h, &f);
+        sk->fwd.table.filled++;
+    }
+
+    if (hv < 0)
+        hv = heuristic(state_at(s)->c, &sk->workers[0]);
+    if (hv >= INF_COST) // Alguma caixa não chega a nenhuma meta livre
+        return;
+    heap_push((node_t){g + hv, g, s});
+}
+
+// Busca A* a partir do estado inicial (com hash hs); retorna o estado final ou 0 se não houver solução
+sidx_t astar(sidx_t start, hash_t hs)
+{
+    worker_t *wk = &sk->workers[0];
+    sidx_t found = 0;
+    astar_queue(state_at(start)->c, hs, 0, 0, -1);
+
+    while (sk->heap_n && !found)
+    {
+        const node_t node = heap_pop();
+        const state_t *s = state_at(node.s);
+        if (node.g != s->g) // Entrada velha: o estado já voltou para a fila com g menor
+            continue;
+        sk->expanded++;
+#ifdef TELEMETRY
+        if (!(sk->expanded & 0xFFFF)) // No A*, a profundidade mostrada é o f do estado expandido
+            tele_progress(node.f, sk->heap_n, sk->fwd.table.filled);
+#endif
+        if (success(s->c))
+        {
+            found = node.s;
+            break;
+        }
+
+        const int hv = node.f - node.g;
+        const hash_t hc = hash(s->c); // O hash não fica no registro, então é refeito a partir das posições
+        hash_t nh;
+        for (int k = 1; k <= sk->n_boxes; k++)
+            wk->occ[s->c[k]] = 1;
+        if (sk->push_mode)
+        {
+            flood(s->c[0], wk->occ, wk->seen, wk->queue);
+            for (int k = 1; k <= sk->n_boxes; k++)
+            {
+                const int b = s->c[k];
+                for (int d = 0; d < 4; d++)
+                {
+                    const int t = b + sk->offsets[d];
+                    if (!wk->seen[b - sk->offsets[d]] || sk->board[t] == wall || !sk->live[t] || wk->occ[t])
+                        continue;
+                    int to = t, player = b, pushes = 1; // Uma macro (-u) custa os empurrões que faz
+                    if (sk->macros)
+                        to = macro_push(s->c, b, d, wk->occ, &player, &pushes);
+                    if (move_box(s->c, hc, b, to, player, true, wk->succ, &nh, wk))
+                        astar_queue(wk->succ, nh, node.s, node.g + pushes, -1);
+                }
+            }
+        }
+        else
+        {
+            for (int d = 0; d < 4; d++)
+            {
+                if (!move_me(s->c, hc, d, wk->succ, &nh, wk))
+                    continue;
+                // Só um empurrão muda as caixas e, portanto, a heurística
+                const bool pushed = wk->occ[wk->succ[0]];
+                astar_queue(wk->succ, nh, node.s, node.g + 1, pushed ? -1 : hv);
+            }
+        }
+        for (int k = 1; k <= sk->n_boxes; k++)
+            wk->occ[s->c[k]] = 0;
+    }
+
+    free(sk->heap);
+    return found;
+}
+
+/*----------- Busca IDA* -----------*/
+
+/* Aprofundamento iterativo com a mesma heurística do A* (-i): cada iteração é uma busca em
+   profundidade que corta os estados com f = g + h acima do limite, e o limite seguinte é o menor
+   f cortado. A memória não depende da profundidade da solução: cada tarefa guarda só o caminho
+   atual (uma linha de posições por nível) e a tabela de transposição tem tamanho fixo (-m).
+
+   Paralelismo: a raiz de cada iteração e os nós que ainda têm bastante limite viram tarefas do
+   OpenMP enquanto houver menos tarefas na fila do que o dobro de threads; uma thread ociosa pega
+   a próxima tarefa da fila. Assim uma subárvore grande continua sendo repartida enquanto as
+   outras já terminaram, e nenhuma thread fica parada com subárvores desiguais.
+
+   Tabela de transposição: uma palavra de 64 bits por posição, com os 40 bits altos do hash, a
+   etiqueta da iteração (8 bits) e o g (16 bits). Chegar a um estado já registrado na mesma
+   iteração com g menor ou igual corta o ramo (inclusive ciclos); posições são sobrescritas sem
+   travas, o que só perde cortes. A solução achada na iteração de limite L tem custo L, que é
+   ótimo (em passos, ou em empurrões com -p), como no A*. */
+
+#define IDA_SPLIT_MIN 8 // folga mínima (limite - f) para um nó virar tarefa
+#define TT_KEY_MASK (~(uint64_t)0xFFFFFF)
+
+// Marca o estado de hash hs com custo g na tabela; retorna false se ele já foi visto com g menor ou igual
+static bool tt_visit(hash_t hs, int g)
+{
+    uint64_t *e = &sk->tt[hs & sk->tt_mask];
+    const uint64_t cur = __atomic_load_n(e, __ATOMIC_RELAXED);
+    if (!((cur ^ hs) & TT_KEY_MASK) && (cur >> 16 & 0xFF) == sk->tt_tag && (int)(cur & 0xFFFF) <= g)
+        return false;
+    __atomic_store_n(e, (hs & TT_KEY_MASK) | sk->tt_tag << 16 | (uint64_t)g, __ATOMIC_RELAXED);
+    return true;
+}
+
+static void ida_dfs(cidx_t *path, int g, hash_t hs, int hv, worker_t *wk);
+
+// Continua a busca a partir do filho (linha g + 1 de path, hash hk), numa tarefa nova se valer a pena
+static void ida_child(cidx_t *path, int g, hash_t hk, int hv, worker_t *wk)
+{
+    const size_t row_bytes = (1 + sk->n_boxes) * sizeof(cidx_t);
+    const cidx_t *kid = path + (size_t)(g + 1) * (1 + sk->n_boxes);
+    if (hv < 0)
+        hv = heuristic(kid, wk);
+    if (hv >= INF_COST) // Alguma caixa não chega a nenhuma meta livre
+        return;
+
+    if (sk->ida_bound - (g + 1 + hv) >= IDA_SPLIT_MIN &&
+        __atomic_load_n(&sk->ida_pending, __ATOMIC_RELAXED) < 2 * sk->n_workers)
+    {
+        // A tarefa leva uma cópia do caminho até o filho, com espaço para o resto do limite
+        cidx_t *copy = malloc((size_t)(sk->ida_bound + 2) * row_bytes);
+        assert(copy);
+        memcpy(copy, path, (size_t)(g + 2) * row_bytes);
+        __atomic_add_fetch(&sk->ida_pending, 1, __ATOMIC_RELAXED);
+#pragma omp task firstprivate(copy, g, hk, hv)
+        {
+            __atomic_sub_fetch(&sk->ida_pending, 1, __ATOMIC_RELAXED);
+            ida_dfs(copy, g + 1, hk, hv, &sk->workers[omp_get_thread_num()]);
+            free(copy);
+        }
+    }
+    else
+        ida_dfs(path, g + 1, hk, hv, wk);
+}
+
+// Busca em profundidade a partir da linha g de path (hash hs, heurística hv), até o limite ida_bound
+static void ida_dfs(cidx_t *path, int g, hash_t hs, int hv, worker_t *wk)
+{
+    const cidx_t *c = path + (size_t)g * (1 + sk->n_boxes);
+    if (__atomic_load_n(&sk->ida_found, __ATOMIC_RELAXED))
+        return;
+    if (g + hv > sk->ida_bound)
+    {
+        int cur = __atomic_load_n(&sk->ida_next, __ATOMIC_RELAXED);
+        while (g + hv < cur && !__atomic_compare_exchange_n(&sk->ida_next, &cur, g + hv, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+        return;
+    }
+    if (success(c))
+    {
+#pragma omp critical(ida_solucao)
+        if (!sk->ida_found)
+        {
+            const size_t bytes = (size_t)(g + 1) * (1 + sk->n_boxes) * sizeof(cidx_t);
+            sk->ida_path = malloc(bytes);
+            assert(sk->ida_path);
+            memcpy(sk->ida_path, path, bytes);
+            sk->ida_len = g + 1;
+            __atomic_store_n(&sk->ida_found, true, __ATOMIC_RELAXED);
+        }
+        return;
+    }
+    if (!tt_visit(hs, g))
+        return;
+    wk->expanded++;
+    cidx_t *kid = path + (size_t)(g + 1) * (1 + sk->n_boxes); // Os filhos são gerados direto na linha seguinte
+    hash_t nh;
+
+    if (sk->push_mode)
+    {
+        // Empurrões a partir da região do jogador; a região é guardada porque os filhos reusam seen
+        int moves[4 * sk->n_boxes][2], n_moves = 0;
+        for (int k = 1; k <= sk->n_boxes; k++)
+            wk->occ[c[k]] = 1;
+        flood(c[0], wk->occ, wk->seen, wk->queue);
+        for (int k = 1; k <= sk->n_boxes; k++)
+            for (int d = 0; d < 4; d++)
+            {
+                const int b = c[k], t = b + sk->offsets[d];
+                if (wk->seen[b - sk->offsets[d]] && sk->board[t] != wall && sk->live[t] && !wk->occ[t])
+                    moves[n_moves][0] = b, moves[n_moves++][1] = t;
+            }
+        for (int k = 1; k <= sk->n_boxes; k++)
+            wk->occ[c[k]] = 0;
+
+        for (int i = 0; i < n_moves; i++)
+        {
+            for (int k = 1; k <= sk->n_boxes; k++)
+                wk->occ[c[k]] = 1;
+            const bool ok = move_box(c, hs, moves[i][0], moves[i][1], moves[i][0], true, kid, &nh, wk);
+            for (int k = 1; k <= sk->n_boxes; k++)
+                wk->occ[c[k]] = 0;
+            if (ok)
+                ida_child(path, g, nh, -1, wk);
+        }
+    }
+    else
+    {
+        // occ é marcado a cada filho porque a busca no filho usa o mesmo vetor
+        for (int d = 0; d < 4; d++)
+        {
+            for (int k = 1; k <= sk->n_boxes; k++)
+                wk->occ[c[k]] = 1;
+            const bool ok = move_me(c, hs, d, kid, &nh, wk);
+            const bool pushed = ok && wk->occ[kid[0]]; // Só um empurrão muda as caixas e, portanto, a heurística
+            for (int k = 1; k <= sk->n_boxes; k++)
+                wk->occ[c[k]] = 0;
+            if (ok)
+                ida_child(path, g, nh, pushed ? -1 : hv, wk);
+        }
+    }
+}
+
+// IDA* a partir do estado inicial (com hash hs); deixa o caminho em ida_path se houver solução
+void ida(sidx_t start, hash_t hs)
+{
+    // Tabela de transposição: a maior potência de 2 de palavras que cabe em -m (e na metade de -M)
+    size_t entries = 1;
+    while (entries * 2 * sizeof(uint64_t) <= sk->ext_budget &&
+           (!sk->mem_limit || entries * 2 * sizeof(uint64_t) <= sk->mem_limit / 2))
+        entries *= 2;
+    sk->tt = table_alloc(entries * sizeof(uint64_t));
+    assert(sk->tt);
+    sk->tt_mask = entries - 1;
+
+    const size_t row_bytes = (1 + sk->n_boxes) * sizeof(cidx_t);
+    const int h0 = heuristic(state_at(start)->c, &sk->workers[0]);
+    for (sk->ida_bound = h0; h0 < INF_COST && !sk->ida_found; sk->ida_bound = sk->ida_next)
+    {
+        if (++sk->tt_tag > 0xFF) // A etiqueta deu a volta: entradas velhas poderiam parecer atuais
+        {
+            memset(sk->tt, 0, entries * sizeof(uint64_t));
+            sk->tt_tag = 1;
+        }
+        sk->ida_next = INT32_MAX;
+        cidx_t *path = malloc((size_t)(sk->ida_bound + 2) * row_bytes); // g vai até ida_bound, e os filhos uma linha além
+        assert(path);
+        memcpy(path, state_at(start)->c, row_bytes);
+
+#pragma omp parallel copyin(sk)
+#pragma omp single
+        ida_dfs(path, 0, hs, h0, &sk->workers[omp_get_thread_num()]);
+
+        free(path);
+#ifdef TELEMETRY
+        size_t total = 0;
+        for (int t = 0; t < sk->n_workers; t++)
+            total += sk->workers[t].expanded;
+        tele_progress(sk->ida_bound, 0, total); // No IDA*, a profundidade mostrada é o limite da iteração
+#endif
+        if (sk->ida_next == INT32_MAX) // Nenhum corte: a árvore inteira foi vista sem solução
+            break;
+    }
+
+    for (int t = 0; t < sk->n_workers; t++)
+        sk->ida_visited += sk->workers[t].expanded;
+    table_release(sk->tt, entries * sizeof(uint64_t));
+}
+
+// Imprime em out o caminho a pé mais curto de `from` até `to` sem empurrar caixas (occ)
+void show_walk(int from, int to, const uint8_t *occ, FILE *out)
+{
+    int *parent = malloc(sk->w * sk->h * sizeof(int));
+    cidx_t *queue = malloc(sk->w * sk->h * sizeof(cidx_t));
+    char *moves = malloc(sk->w * sk->h + 1);
+    assert(parent && queue && moves);
+    for (int i = 0; i < sk->w * sk->h; i++)
+        parent[i] = -1;
+
+    int head = 0, tail = 0;
+    queue[tail++] = from;
+    parent[from] = from;
+    while (head < tail && parent[to] < 0)
+    {
+        const int c = queue[head++];
+        for (int d = 0; d < 4; d++)
+        {
+            const int n = c + sk->offsets[d];
+            if (n < 0 || n >= sk->w * sk->h || sk->board[n] == wall || occ[n] || parent[n] >= 0)
+                continue;
+            parent[n] = c;
+            queue[tail++] = n;
+        }
+    }
+    if (parent[to] < 0) // O caminho refeito não bate com os estados: marca failed e não imprime nada
+    {
+        fprintf(stderr, "Movimento inválido\n");
+        sk->failed = true;
+        to = from;
+    }
+
+    // Refaz o caminho de trás para frente e imprime na ordem certa
+    int len = 0;
+    for (int c = to; c != from; c = parent[c])
+    {
+        const int diff = c - parent[c];
+        moves[len++] = diff == 1 ? 'r' : diff == -1 ? 'l' : diff < 0 ? 'u' : 'd';
+    }
+    while (len)
+        fputc(moves[--len], out);
+
+    free(parent);
+    free(queue);
+    free(moves);
+}
+
+// Imprime os empurrões de uma macro (-u): a caixa vai de `from` até `to`, com o jogador saindo de
+// `player` e terminando na região de `region` (o jogador canônico do estado seguinte). occ marca as
+// caixas de antes da macro. Os empurrões são refeitos por box_bfs; retorna onde o jogador termina
+int show_macro(int player, int from, int to, int region, uint8_t *occ, FILE *out)
+{
+    int *dist = malloc((size_t)sk->w * sk->h * 4 * sizeof(int)), *prev = malloc((size_t)sk->w * sk->h * 4 * sizeof(int));
+    int *nodes = malloc((size_t)sk->w * sk->h * 4 * sizeof(int));
+    uint8_t *seen = malloc(sk->w * sk->h);
+    cidx_t *queue = malloc(sk->w * sk->h * sizeof(cidx_t));
+    assert(dist && prev && nodes && seen && queue);
+    occ[from] = 0;
+    box_bfs(from, player, occ, dist, prev);
+
+    // O caminho mais curto que deixa a caixa em `to` e o jogador na região do estado seguinte
+    int end = -1;
+    for (int d = 0; d < 4; d++)
+    {
+        const int n = to * 4 + d;
+        if (dist[n] < 0 || (end >= 0 && dist[n] >= dist[end]))
+            continue;
+        occ[to] = 1;
+        flood(to - sk->offsets[d], occ, seen, queue);
+        occ[to] = 0;
+        if (seen[region])
+            end = n;
+    }
+    assert(end >= 0);
+
+    int len = 0, box = from;
+    for (int n = end; n >= 0; n = prev[n])
+        nodes[len++] = n;
+    while (len)
+    {
+        const int d = nodes[--len] & 3;
+        occ[box] = 1;
+        show_walk(player, box - sk->offsets[d], occ, out);
+        occ[box] = 0;
+        fputc("RLUD"[d], out);
+        player = box;
+        box += sk->offsets[d];
+    }
+    occ[from] = 1;
+
+    free(dist);
+    free(prev);
+    free(nodes);
+    free(seen);
+    free(queue);
+    return player;
+}
+
+// Função para exibir uma solução dada como sequência de estados do modo de empurrões
+// Entre dois estados consecutivos, anda até ficar atrás da caixa que mudou e a empurra
+void show_path(const cidx_t **path, int n, FILE *out)
+{
+    uint8_t *occ = sk->workers[0].occ;
+    int player = sk->start_player;
+    for (int k = 1; k < n; k++)
+    {
+        const cidx_t *a = path[k - 1], *b = path[k];
+
+        // Acha a caixa que saiu (from) e a que entrou (to) comparando os vetores ordenados
+        int from = -1, to = -1;
+        for (int i = 1, j = 1; i <= sk->n_boxes || j <= sk->n_boxes;)
+        {
+            if (j > sk->n_boxes || (i <= sk->n_boxes && a[i] < b[j]))
+                from = a[i++];
+            else if (i > sk->n_boxes || b[j] < a[i])
+                to = b[j++];
+            else
+                i++, j++;
+        }
+
+        int d = 0;
+        while (d < 4 && to - from != sk->offsets[d])
+            d++;
+
+        for (int i = 1; i <= sk->n_boxes; i++)
+            occ[a[i]] = 1;
+        if (d < 4)
+        {
+            show_walk(player, from - sk->offsets[d], occ, out); // Anda até ficar atrás da caixa
+            fputc("RLUD"[d], out);                          // Empurra
+            player = from;
+        }
+        else // Macro (-u): a caixa andou várias casas
+            player = show_macro(player, from, to, b[0], occ, out);
+        for (int i = 1; i <= sk->n_boxes; i++)
+            occ[a[i]] = 0;
+        if (sk->failed) // show_walk não achou o caminho
+            break;
+    }
+    fprintf(out, "\n");
+}
+
+// Função para exibir a solução do modo de empurrões
+// Percorre a cadeia de estados de forma iterativa, do final para o início, e mostra o caminho
+void show_pushes(sidx_t s, FILE *out)
+{
+    int n = 0;
+    for (sidx_t p = s; p; p = state_at(p)->prev)
+        n++;
+    const cidx_t **path = malloc(n * sizeof(cidx_t *));
+    assert(path);
+    for (int k = n; k--; s = state_at(s)->prev)
+        path[k] = state_at(s)->c;
+
+    show_path(path, n, out);
+    free(path);
+}
+
+// Função para exibir a solução da busca bidirecional
+// Junta a cadeia do lado para frente (início até o encontro) com a do lado para trás (encontro até as metas)
+void show_meeting(FILE *out)
+{
+    const cidx_t *c = state_at(sk->done)->c;
+    sidx_t a = sk->done_side == &sk->fwd ? sk->done : lookup(&sk->fwd.table, c, hash(c));
+    sidx_t b = sk->done_side == &sk->bwd ? sk->done : lookup(&sk->bwd.table, c, hash(c));
+    assert(a && b);
+
+    int na = 0, n = 0;
+    for (sidx_t p = a; p; p = state_at(p)->prev)
+        na++;
+    for (sidx_t p = state_at(b)->prev; p; p = state_at(p)->prev)
+        n++;
+    n += na;
+
+    const cidx_t **path = malloc(n * sizeof(cidx_t *));
+    assert(path);
+    for (int k = na; k--; a = state_at(a)->prev)
+        path[k] = state_at(a)->c;
+    for (int k = na; (b = state_at(b)->prev); k++)
+        path[k] = state_at(b)->c;
+
+    show_path(path, n, out);
+    free(path);
+}
+
+// Função para exibir uma solução da busca por passos dada como sequência de n estados
+// Cada estado difere do anterior por um passo do jogador, que empurra se havia caixa no destino
+void show_steps(const cidx_t **path, int n, FILE *out)
+{
+    for (int k = 1; k < n; k++)
+    {
+        const cidx_t *a = path[k - 1], *b = path[k];
+        int d = 0, box = 0;
+        while (d < 4 && b[0] - a[0] != sk->offsets[d])
+            d++;
+        if (d == 4) // Estados consecutivos que não diferem por um passo
+        {
+            fprintf(stderr, "Movimento inválido\n");
+            sk->failed = true;
+            break;
+        }
+        for (int i = 1; !box && i <= sk->n_boxes; i++)
+            box = a[i] == b[0];
+        fputc((box ? "RLUD" : "rlud")[d], out);
+    }
+    fprintf(out, "\n");
+}
+
+// Função para exibir os movimentos feitos em out
+// Percorre a cadeia de estados de forma iterativa, do final para o início (como show_pushes)
+void show_moves(sidx_t s, FILE *out)
+{
+    int n = 0;
+    for (sidx_t p = s; p; p = state_at(p)->prev)
+        n++;
+    const cidx_t **path = malloc(n * sizeof(cidx_t *));
+    assert(path);
+    for (int k = n; k--; s = state_at(s)->prev)
+        path[k] = state_at(s)->c;
+
+    show_steps(path, n, out);
+    free(path);
+}
+
+// Função para exibir uma solução dada como sequência de n linhas de posições (IDA*, busca só com a
+// fronteira e busca distribuída)
+void show_rows(const cidx_t *rows, int n, FILE *out)
+{
+    const cidx_t **path = malloc(n * sizeof(cidx_t *));
+    assert(path);
+    for (int k = 0; k < n; k++)
+        path[k] = rows + (size_t)k * (1 + sk->n_boxes);
+
+    if (sk->push_mode)
+        show_path(path, n, out); // Refaz os passos entre os empurrões
+    else
+        show_steps(path, n, out);
+    free(path);
+}
+
+// Verifica se o motor usado achou uma solução
+bool solved()
+{
+#ifdef USE_MPI
+    if (sk->distributed)
+        return sk->mpi_path;
+#endif
+    return sk->done || sk->ext_solution || sk->ida_path || sk->lean_path;
+}
+
+// Estados visitados pelo motor usado (os dois lados, as camadas em disco ou as iterações)
+size_t visited_states()
+{
+#ifdef USE_MPI
+    if (sk->distributed)
+        return sk->mpi_visited; // Soma das tabelas de todos os processos
+#endif
+    return sk->fwd.table.filled + sk->bwd.table.filled + sk->ext_visited + sk->ida_visited + sk->lean_visited;
+}
+
+// Exibe em out a solução encontrada (done), de acordo com o modo de busca
+void show_solution(FILE *out)
+{
+    if (sk->external)
+        fputs(sk->ext_solution, out); // Já refeita por ext_rebuild
+    else if (sk->ida_mode)
+        show_rows(sk->ida_path, sk->ida_len, out);
+    else if (sk->lean)
+        show_rows(sk->lean_path, sk->lean_len, out); // Já refeita por lean_bfs
+#ifdef USE_MPI
+    else if (sk->distributed)
+        show_rows(sk->mpi_path, sk->mpi_len, out); // Já reunida por mpi_rebuild
+#endif
+    else if (sk->bidirectional)
+        show_meeting(out); // Junta as duas metades do caminho
+    else if (sk->push_mode)
+        show_pushes(sk->done, out); // Refaz os passos entre os empurrões
+    else
+        show_moves(sk->done, out); // Mostra a sequência de movimentos
+}
+
+/*----------- Leitura de níveis -----------*/
+
+// Verifica se a linha [s, end) é uma linha de tabuleiro: o primeiro caractere não branco é '#'
+static bool board_line(const char *s, const char *end)
+{
+    while (s < end && (*s == ' ' || *s == '\t'))
+        s++;
+    return s < end && *s == '#';
+}
+
+// Copia o nível [text, text + len) para uma string retangular: todas as linhas ficam com a largura
+// da maior, completadas com espaço e terminadas em '\n' (assim w conta a coluna do '\n'). Os
+// caracteres '-' e '_', usados como chão em algumas coleções, viram espaço. Define w e h.
+char *pad_level(const char *text, size_t len)
+{
+    const char *end = text + len;
+    int max = 0;
+    sk->h = 0;
+    for (const char *l = text; l < end; sk->h++)
+    {
+        const char *e = memchr(l, '\n', end - l);
+        if (!e)
+            e = end;
+        int n = e - l;
+        if (n && l[n - 1] == '\r')
+            n--;
+        if (n > max)
+            max = n;
+        l = e + 1;
+    }
+    sk->w = max + 1;
+
+    char *b = malloc((size_t)sk->w * sk->h + 1);
+    assert(b);
+    const char *l = text;
+    for (int y = 0; y < sk->h; y++)
+    {
+        char *r = b + (size_t)y * sk->w;
+        int x = 0;
+        for (; l < end && *l != '\n' && *l != '\r'; l++)
+            r[x++] = *l == '-' || *l == '_' ? ' ' : *l;
+        while (l < end && *l != '\n')
+            l++;
+        l++;
+        memset(r + x, ' ', sk->w - 1 - x);
+        r[sk->w - 1] = '\n';
+    }
+    b[(size_t)sk->w * sk->h] = '\0';
+    return b;
+}
+
+// Verifica se o nível (string de pad_level) pode ser resolvido: retorna a mensagem do problema, ou NULL
+const char *level_error(const char *text)
+{
+    int players = 0;
+    for (const char *c = text; *c; c++)
+        players += *c == '@' || *c == '+';
+    if (players != 1)
+        return players ? "O nível tem mais de um jogador" : "O nível não tem jogador";
+    return NULL;
+}
+
+/*----------- Cache da análise do nível -----------*/
+
+/* Com -k dir, a análise estática do nível (células vivas, vizinhos, metas, distâncias até as
+   metas, corredores e salas de metas) fica num arquivo do diretório cujo nome é o hash da
+   disposição de paredes e metas, que é tudo de que ela depende. Numa nova execução com a mesma
+   disposição (o mesmo nível, ou outro com as caixas e o jogador em outras casas), o arquivo é
+   mapeado com mmap e os vetores apontam direto para ele, sem refazer nada. Na falta, a análise é
+   feita por completo, com as distâncias e as salas mesmo que o motor não as use, e gravada num
+   arquivo temporário renomeado no fim, o que deixa resoluções simultâneas (-f, mpirun, contextos
+   da biblioteca) gravarem o mesmo nível sem se atrapalhar. O banco de padrões de -g, bem mais caro
+   de construir, é guardado do mesmo jeito num arquivo à parte. */
+#define CACHE_MAGIC "SOKOPRE2"
+
+typedef struct
+{
+    char magic[8];   // CACHE_MAGIC
+    uint64_t key;    // hash da disposição (também o nome do arquivo)
+    int32_t w, h;    // dimensões do nível
+    int32_t n_goals; // quantidade de metas
+    int32_t n_rooms; // quantidade de salas de metas
+} cache_header_t;
+
+// Bytes de uma seção do arquivo, arredondados para manter as seções alinhadas a 8 bytes
+static inline size_t cache_pad(size_t bytes)
+{
+    return (bytes + 7) & ~(size_t)7;
+}
+
+// Tamanho do arquivo de cache de um nível com n metas: cabeçalho, disposição, live, neighbor,
+// goal_cells, goal_dist, corridor, room_of, door_of, goal_rank, room_first, room_seq e room_macro,
+// nessa ordem
+static size_t cache_bytes(int n)
+{
+    const size_t cells = (size_t)sk->w * sk->h;
+    return cache_pad(sizeof(cache_header_t)) + 3 * cache_pad(cells) + cache_pad(cells * 4 * sizeof(int)) +
+           2 * cache_pad(n * sizeof(int)) + cache_pad((size_t)n * cells * sizeof(uint16_t)) +
+           3 * cache_pad(cells * sizeof(int)) + cache_pad((n + 1) * sizeof(int)) + cache_pad((size_t)n * 8 * sizeof(int));
+}
+
+// Disposição de paredes e metas ('#', '.' ou ' ' por célula), que identifica o nível no cache; devolve o hash FNV-1a dela
+hash_t cache_layout(uint8_t *layout)
+{
+    hash_t key = 0xCBF29CE484222325ull;
+    for (int i = 0; i < sk->w * sk->h; i++)
+    {
+        layout[i] = sk->board[i] == wall ? '#' : sk->goals[i] ? '.' : ' ';
+        key = (key ^ layout[i]) * 0x100000001B3ull;
+    }
+    return (key ^ (uint64_t)sk->w << 32 ^ (uint64_t)sk->h) * 0x100000001B3ull;
+}
+
+// Caminho do arquivo de cache com a chave e a terminação dadas (alocado; o chamador libera)
+char *cache_path(hash_t key, const char *suffix)
+{
+    char *path = malloc(strlen(sk->cache_dir) + strlen(suffix) + 64);
+    assert(path);
+    sprintf(path, "%s/sokoban-%016llx%s", sk->cache_dir, (unsigned long long)key, suffix);
+    return path;
+}
+
+// Mapeia só para leitura o arquivo de cache em path (que é liberado), se tiver pelo menos min bytes
+// Retorna o mapeamento e o tamanho em *size, ou NULL se o arquivo não existir ou for menor
+static uint8_t *cache_open(char *path, size_t min, size_t *size)
+{
+    const int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    uint8_t *map = fstat(fd, &st) || st.st_size < (off_t)min
+                       ? MAP_FAILED
+                       : mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    *size = st.st_size;
+    return map;
+}
+
+// Mapeia o arquivo de cache da disposição e aponta os vetores da análise para ele
+// Retorna false se o arquivo não existir ou não for desta disposição
+bool cache_load(hash_t key, const uint8_t *layout)
+{
+    size_t size;
+    uint8_t *map = cache_open(cache_path(key, ".pre"), sizeof(cache_header_t), &size);
+    if (!map)
+        return false;
+
+    const cache_header_t *hd = (const cache_header_t *)map;
+    const size_t cells = (size_t)sk->w * sk->h;
+    uint8_t *p = map + cache_pad(sizeof(cache_header_t));
+    if (memcmp(hd->magic, CACHE_MAGIC, sizeof(hd->magic)) || hd->key != key || hd->w != sk->w || hd->h != sk->h ||
+        hd->n_goals < 0 || size != cache_bytes(hd->n_goals) || memcmp(p, layout, cells))
+    {
+        munmap(map, size);
+        return false;
+    }
+    p += cache_pad(cells);
+    sk->live = p;
+    p += cache_pad(cells);
+    sk->neighbor = (int *)p;
+    p += cache_pad(cells * 4 * sizeof(int));
+    sk->n_goals = hd->n_goals;
+    sk->goal_cells = (int *)p;
+    p += cache_pad(sk->n_goals * sizeof(int));
+    sk->goal_dist = (uint16_t *)p;
+    p += cache_pad((size_t)sk->n_goals * cells * sizeof(uint16_t));
+    sk->corridor = p;
+    p += cache_pad(cells);
+    sk->room_of = (int *)p;
+    p += cache_pad(cells * sizeof(int));
+    sk->door_of = (int *)p;
+    p += cache_pad(cells * sizeof(int));
+    sk->goal_rank = (int *)p;
+    p += cache_pad(cells * sizeof(int));
+    sk->n_rooms = hd->n_rooms;
+    sk->room_first = (int *)p;
+    p += cache_pad((sk->n_goals + 1) * sizeof(int));
+    sk->room_seq = (int *)p;
+    p += cache_pad(sk->n_goals * sizeof(int));
+    sk->room_macro = (int *)p;
+
+    sk->cache_map = map;
+    sk->cache_size = size;
+    return true;
+}
+
+// Grava uma seção do arquivo de cache com o preenchimento até 8 bytes; retorna false se falhar
+static bool cache_put(FILE *f, const void *data, size_t bytes)
+{
+    static const uint8_t zeros[8];
+    return fwrite(data, 1, bytes, f) == bytes &&
+           fwrite(zeros, 1, cache_pad(bytes) - bytes, f) == cache_pad(bytes) - bytes;
+}
+
+// Nome do arquivo temporário em que o arquivo de cache path é gravado antes de renomeado (alocado)
+static char *cache_tmp(const char *path)
+{
+    char *tmp = malloc(strlen(path) + 32);
+    assert(tmp);
+    sprintf(tmp, "%s.%d-%u.tmp", path, (int)getpid(), sk->id);
+    return tmp;
+}
+
+// Fecha f e renomeia tmp para path se tudo foi gravado (ok); libera os dois nomes
+// Uma falha só gera um aviso: a busca não depende do cache
+static void cache_commit(FILE *f, bool ok, char *tmp, char *path)
+{
+    if (f && fclose(f))
+        ok = false;
+    if (!ok || rename(tmp, path))
+    {
+        perror(tmp);
+        unlink(tmp);
+    }
+    free(tmp);
+    free(path);
+}
+
+// Grava a análise feita (live, neighbor, init_goal_dist e init_macros) no arquivo da disposição
+void cache_save(hash_t key, const uint8_t *layout)
+{
+    char *path = cache_path(key, ".pre"), *tmp = cache_tmp(path);
+    FILE *f = fopen(tmp, "wb");
+    cache_header_t hd = {.magic = CACHE_MAGIC, .key = key, .w = sk->w, .h = sk->h, .n_goals = sk->n_goals, .n_rooms = sk->n_rooms};
+    const size_t cells = (size_t)sk->w * sk->h;
+    bool ok = f && cache_put(f, &hd, sizeof(hd)) && cache_put(f, layout, cells) &&
+              cache_put(f, sk->live, cells) && cache_put(f, sk->neighbor, cells * 4 * sizeof(int)) &&
+              cache_put(f, sk->goal_cells, sk->n_goals * sizeof(int)) &&
+              cache_put(f, sk->goal_dist, (size_t)sk->n_goals * cells * sizeof(uint16_t)) &&
+              cache_put(f, sk->corridor, cells) && cache_put(f, sk->room_of, cells * sizeof(int)) &&
+              cache_put(f, sk->door_of, cells * sizeof(int)) && cache_put(f, sk->goal_rank, cells * sizeof(int)) &&
+              cache_put(f, sk->room_first, (sk->n_goals + 1) * sizeof(int)) && cache_put(f, sk->room_seq, sk->n_goals * sizeof(int)) &&
+              cache_put(f, sk->room_macro, (size_t)sk->n_goals * 8 * sizeof(int));
+    cache_commit(f, ok, tmp, path);
+}
+
+// Análise estática do nível: do cache de -k, se houver, ou calculada (e gravada no cache)
+// Precisa de board, goals e offsets; as distâncias só são garantidas se need_dist, e as salas com -u
+void analyze_level(bool need_dist)
+{
+    uint8_t *layout = NULL;
+    hash_t key = 0;
+    if (sk->cache_dir)
+    {
+        layout = malloc((size_t)sk->w * sk->h);
+        assert(layout);
+        key = cache_layout(layout);
+        if (cache_load(key, layout))
+        {
+            free(layout);
+            return;
+        }
+    }
+
+    mark_live();
+    init_neighbors();
+    if (need_dist || sk->macros || sk->cache_dir)
+        init_goal_dist();
+    if (sk->macros || sk->cache_dir)
+        init_macros();
+    if (sk->cache_dir)
+        cache_save(key, layout);
+    free(layout);
+}
+
+// Libera os vetores da análise (o mapeamento do cache, se vieram dele)
+void release_analysis()
+{
+    if (sk->cache_map)
+        munmap(sk->cache_map, sk->cache_size);
+    else
+    {
+        free(sk->live);
+        free(sk->neighbor);
+        free(sk->goal_cells);
+        free(sk->goal_dist);
+        free(sk->corridor);
+        free(sk->room_of);
+        free(sk->door_of);
+        free(sk->goal_rank);
+        free(sk->room_first);
+        free(sk->room_seq);
+        free(sk->room_macro);
+    }
+    sk->cache_map = NULL;
+    sk->live = NULL, sk->neighbor = NULL, sk->goal_cells = NULL, sk->goal_dist = NULL;
+    sk->corridor = NULL, sk->room_of = sk->door_of = sk->goal_rank = sk->room_first = sk->room_seq = sk->room_macro = NULL;
+}
+
+/* O banco de padrões de -g fica em outro arquivo da mesma disposição, um por tamanho de padrão,
+   com o cabeçalho, a disposição e a tabela; ele também é mapeado direto, e pdb aponta para ele. */
+#define PDB_MAGIC "SOKOPDB1"
+
+typedef struct
+{
+    char magic[8];   // PDB_MAGIC
+    uint64_t key;    // hash da disposição
+    int32_t w, h;    // dimensões do nível
+    int32_t k;       // caixas por padrão
+    int32_t n_live;  // quantidade de casas vivas
+    uint64_t states; // estados alcançados na construção
+} pdb_header_t;
+
+// Caminho do arquivo do banco de -g com a chave dada (alocado; o chamador libera)
+static char *pdb_path(hash_t key)
+{
+    char suffix[32];
+    sprintf(suffix, "-g%d.pdb", sk->pdb_k);
+    return cache_path(key, suffix);
+}
+
+// Mapeia o arquivo do banco da disposição (precisa de pdb_index); retorna false se não for deste nível
+bool pdb_load(hash_t key, const uint8_t *layout)
+{
+    size_t size;
+    uint8_t *map = cache_open(pdb_path(key), sizeof(pdb_header_t), &size);
+    if (!map)
+        return false;
+
+    const pdb_header_t *hd = (const pdb_header_t *)map;
+    const size_t cells = (size_t)sk->w * sk->h, head = cache_pad(sizeof(pdb_header_t)) + cache_pad(cells);
+    if (memcmp(hd->magic, PDB_MAGIC, sizeof(hd->magic)) || hd->key != key || hd->w != sk->w || hd->h != sk->h ||
+        hd->k != sk->pdb_k || hd->n_live != sk->pdb_live || size != head + cache_pad(sk->pdb_bytes) ||
+        memcmp(map + cache_pad(sizeof(pdb_header_t)), layout, cells))
+    {
+        munmap(map, size);
+        return false;
+    }
+    sk->pdb = map + head;
+    sk->pdb_states = hd->states;
+    sk->pdb_map = map;
+    sk->pdb_map_size = size;
+    return true;
+}
+
+// Grava o banco construído por init_pdb no arquivo da disposição
+void pdb_save(hash_t key, const uint8_t *layout)
+{
+    char *path = pdb_path(key), *tmp = cache_tmp(path);
+    FILE *f = fopen(tmp, "wb");
+    pdb_header_t hd = {.magic = PDB_MAGIC, .key = key, .w = sk->w, .h = sk->h, .k = sk->pdb_k, .n_live = sk->pdb_live, .states = sk->pdb_states};
+    const bool ok = f && cache_put(f, &hd, sizeof(hd)) && cache_put(f, layout, (size_t)sk->w * sk->h) && cache_put(f, sk->pdb, sk->pdb_bytes);
+    cache_commit(f, ok, tmp, path);
+}
+
+// Libera o banco de -g (o mapeamento do cache, se veio dele) e os índices
+void release_pdb()
+{
+    if (sk->pdb_map)
+        munmap(sk->pdb_map, sk->pdb_map_size);
+    else
+        table_release(sk->pdb, sk->pdb_bytes);
+    free(sk->pdb_live_idx);
+    free(sk->pdb_floor_idx);
+    free(sk->pdb_binom);
+    sk->pdb = sk->pdb_map = NULL;
+    sk->pdb_live_idx = sk->pdb_floor_idx = NULL, sk->pdb_binom = NULL;
+}
+
+// Banco de padrões de -g: do cache de -k, se houver, ou construído (e gravado no cache)
+// Precisa da análise do nível; se o banco não couber em -M, a busca segue só com o emparelhamento
+void prepare_pdb()
+{
+    const double t0 = omp_get_wtime();
+    if (!pdb_index())
+    {
+        fprintf(stderr, "Banco de padrões de %d caixas (%zu MiB) não cabe em -M; seguindo sem ele\n",
+                sk->pdb_k, sk->pdb_bytes >> 20);
+        release_pdb();
+        sk->pdb_k = 0;
+        return;
+    }
+
+    // Espaço para todos os grupos de pdb_k caixas em pdb_cost: C(n_boxes, pdb_k)
+    size_t groups = sk->n_boxes >= sk->pdb_k;
+    for (int i = 0; groups && i < sk->pdb_k; i++)
+        groups = groups * (sk->n_boxes - i) / (i + 1);
+    for (int t = 0; t < sk->n_workers; t++)
+    {
+        sk->workers[t].pdb_cand = malloc((groups + 1) * (sk->pdb_k + 1) * sizeof(int));
+        assert(sk->workers[t].pdb_cand);
+    }
+
+    uint8_t *layout = NULL;
+    hash_t key = 0;
+    if (sk->cache_dir)
+    {
+        layout = malloc((size_t)sk->w * sk->h);
+        assert(layout);
+        key = cache_layout(layout);
+    }
+    if (!sk->cache_dir || !pdb_load(key, layout))
+    {
+        init_pdb();
+        if (sk->cache_dir)
+            pdb_save(key, layout);
+    }
+    free(layout);
+    sk->pdb_ms = (omp_get_wtime() - t0) * 1000;
+}
+
+// Prepara as tabelas do nível (string retangular de pad_level) e o resolve com o motor escolhido
+// Deixa o estado final em done, ou 0 se não houver solução (já sem busca com mais caixas que metas)
+void solve(const char *boardStr)
+{
+#ifdef TELEMETRY
+    sk->tele_t0 = sk->tele_last = omp_get_wtime();
+#endif
+    // Prepara as arenas e áreas de rascunho de cada thread
+    init_workers();
+    sk->level_text = boardStr;
+
+    // Faz o parsing da string para o estado inicial do tabuleiro
+    const sidx_t start = parse_board(boardStr);
+    state_t *s = state_at(start);
+    init_zobrist();
+
+    sk->offsets[0] = 1, sk->offsets[1] = -1, sk->offsets[2] = -sk->w, sk->offsets[3] = sk->w;
+
+    // Com mais caixas que metas não há solução: nenhum motor começa, e as heurísticas do A* e do
+    // IDA* não são chamadas sem uma atribuição possível
+    int n_goals = 0;
+    for (int i = 0; i < sk->w * sk->h; i++)
+        n_goals += sk->goals[i];
+    if (n_goals < sk->n_boxes)
+        return;
+
+    // Células vivas, vizinhos e as tabelas de distância até as metas (heurística do A* e do IDA*
+    // e teste de emparelhamento), do cache de -k quando houver
+    const bool need_dist = sk->astar_mode || sk->ida_mode || (sk->deadlock_checks & 1 << DL_MATCH);
+    analyze_level(need_dist);
+    if (need_dist)
+        init_matching();
+    if (sk->pdb_k) // Banco de padrões da heurística (-g)
+        prepare_pdb();
+
+    sk->start_player = s->c[0];
+    if (sk->push_mode)
+        normalize(s, &sk->workers[0]);
+    const hash_t hs = hash(s->c);
+
+    // Resolve com o motor escolhido
+    if (sk->astar_mode)
+        sk->done = astar(start, hs), sk->done_side = &sk->fwd;
+    else if (sk->ida_mode)
+        ida(start, hs);
+    else if (sk->external)
+        ext_bfs(s);
+    else if (sk->lean)
+        lean_bfs(start);
+#ifdef USE_MPI
+    else if (sk->distributed)
+        mpi_bfs(start, hs);
+#endif
+    else
+        bfs(start, hs);
+}
+
+// Libera a memória alocada para o nível resolvido por solve
+void release_level()
+{
+    free_table(&sk->fwd.table); // Libera as tabelas de hash
+    free_table(&sk->bwd.table);
+    free_frontier(&sk->fwd.level);
+    free_frontier(&sk->bwd.level);
+    free(sk->board); // Libera o tabuleiro
+    free(sk->goals); // Libera os objetivos
+    release_analysis(); // Libera as células vivas, os vizinhos e as distâncias até as metas
+    release_pdb();
+    free(sk->zobrist_player);
+    free(sk->zobrist_box);
+    free(sk->ext_solution);
+    free(sk->ida_path);
+    free(sk->lean_path);
+#ifdef USE_MPI
+    free(sk->mpi_path);
+    free(sk->mpi_filled);
+#endif
+#ifdef TELEMETRY
+    free(sk->layer_stats);
+    free(sk->spans);
+#endif
+
+    // Libera as arenas (todos os blocos de estados) e as áreas de rascunho
+    free_workers();
+}
+
+// Milissegundos desde t0
+double ms_since(const struct timeval *t0)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (t.tv_sec - t0->tv_sec) * 1000.0 + (t.tv_usec - t0->tv_usec) / 1000.0;
+}
+
+/*----------- Modo em lote -----------*/
+
+/* Resolve todos os níveis de uma coleção (formato XSB: níveis separados por linhas que não são de
+   tabuleiro, como títulos, comentários ';' e linhas em branco). O arquivo é mapeado com mmap e os
+   níveis são indexados sem cópia, como trechos do mapeamento. Um grupo de `jobs` threads resolve os
+   níveis, cada thread no seu próprio contexto e com a sua equipe do OpenMP, tirando o próximo nível
+   de uma fila única. Os níveis de maior custo estimado saem primeiro, para que os maiores não
+   fiquem para o fim com os outros núcleos parados. No fim, uma linha por nível, na ordem da coleção,
+   com o tempo de cada um. Como o limite de memória (-M) termina o processo, ele não vale aqui. */
+
+// Nível da coleção: trecho do arquivo mapeado e custo estimado da busca
+typedef struct
+{
+    const char *text; // primeira linha do nível no mapeamento
+    size_t len;       // bytes do nível
+    int index;        // número do nível na coleção (a partir de 1)
+    double cost;      // estimativa do tamanho da busca: C(chão, caixas) * chão
+} level_t;
+
+// Fila e resultados do modo em lote, compartilhados pelas threads do grupo
+typedef struct
+{
+    const sokoban_t *options; // contexto com as opções da linha de comando (nada resolvido nele)
+    level_t **order;          // níveis em ordem de resolução
+    size_t n, next;           // quantidade de níveis e próximo da fila (atômico)
+    int threads;              // threads do OpenMP de cada resolução
+    char **solution;          // saída de cada nível, pelo índice na coleção (NULL se não resolvido)
+    int *status;              // 0 resolvido, 1 sem solução, 2 erro
+    double *ms;               // tempo de cada nível
+} batch_t;
+
+// Encontra os níveis em data e estima o custo de cada um; retorna a quantidade
+size_t index_levels(const char *data, size_t size, level_t **out)
+{
+    const char *end = data + size;
+    size_t n = 0, cap = 64;
+    level_t *levels = malloc(cap * sizeof(level_t));
+    assert(levels);
+
+    for (const char *l = data; l < end;)
+    {
+        const char *e = memchr(l, '\n', end - l);
+        e = e ? e + 1 : end;
+        if (!board_line(l, e))
+        {
+            l = e;
+            continue;
+        }
+
+        // Junta as linhas de tabuleiro consecutivas, contando chão (depois do primeiro '#' da linha) e caixas
+        if (n == cap)
+        {
+            levels = realloc(levels, (cap *= 2) * sizeof(level_t));
+            assert(levels);
+        }
+        level_t *lv = &levels[n];
+        lv->text = l;
+        int floor = 0, boxes = 0;
+        for (; l < end && board_line(l, e); l = e, e = memchr(l, '\n', end - l), e = e ? e + 1 : end)
+        {
+            const char *c = l;
+            while (*c != '#')
+                c++;
+            for (; c < e; c++)
+            {
+                floor += *c != '#' && *c != '\n' && *c != '\r';
+                boxes += *c == '$' || *c == '*';
+            }
+        }
+        lv->len = l - lv->text;
+        lv->index = ++n;
+        lv->cost = floor;
+        for (int k = 0; k < boxes; k++)
+            lv->cost = lv->cost * (floor - k) / (k + 1);
+    }
+
+    *out = levels;
+    return n;
+}
+
+// Ordem de resolução: maior custo estimado primeiro e, empatado, a ordem da coleção
+static int by_cost(const void *a, const void *b)
+{
+    const level_t *x = *(level_t *const *)a, *y = *(level_t *const *)b;
+    if (x->cost != y->cost)
+        return x->cost < y->cost ? 1 : -1;
+    return x->index - y->index;
+}
+
+// Thread do grupo: resolve níveis da fila num contexto próprio até a fila acabar
+static void *batch_worker(void *arg)
+{
+    batch_t *b = arg;
+    sk = sokoban_new();
+    assert(sk);
+    omp_set_num_threads(b->threads);
+
+    for (size_t k; (k = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED)) < b->n;)
+    {
+        const level_t *lv = b->order[k];
+        const size_t i = lv->index - 1;
+        struct timeval start;
+        gettimeofday(&start, NULL);
+
+        // Cada nível começa das opções, com o estado da busca zerado
+        memcpy(sk, b->options, offsetof(sokoban_t, id));
+        char *text = pad_level(lv->text, lv->len);
+        if (level_error(text))
+            sk->failed = true; // Nível malformado: erro, sem busca
+        else
+            solve(text);
+        b->status[i] = sk->failed ? 2 : !solved();
+        if (!b->status[i])
+        {
+            size_t len;
+            FILE *out = open_memstream(&b->solution[i], &len);
+            assert(out);
+            show_solution(out);
+            fclose(out);
+            if (sk->failed) // Caminho inconsistente
+            {
+                free(b->solution[i]);
+                b->solution[i] = NULL;
+                b->status[i] = 2;
+            }
+        }
+        release_level();
+        free(text);
+        b->ms[i] = ms_since(&start);
+    }
+
+    sokoban_free(sk);
+    sk = NULL;
+    return NULL;
+}
+
+// Mapeia o arquivo em path e indexa os seus níveis; retorna false (com a mensagem de erro) se não
+// conseguir ler o arquivo ou se ele não tiver nenhum nível. *data fica mapeado até unmap_levels.
+bool map_levels(const char *path, const char **data, size_t *size, level_t **levels, size_t *n)
+{
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        perror(path);
+        return false;
+    }
+    *size = st.st_size;
+    *data = *size ? mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (*data == MAP_FAILED)
+    {
+        perror(path);
+        return false;
+    }
+
+    *n = index_levels(*data, *size, levels);
+    if (!*n)
+    {
+        fprintf(stderr, "Nenhum nível em %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Desfaz o mapeamento e o índice de map_levels
+void unmap_levels(const char *data, size_t size, level_t *levels)
+{
+    free(levels);
+    if (data)
+        munmap((void *)data, size);
+}
+
+// Resolve todos os níveis do arquivo em path com até `jobs` níveis ao mesmo tempo
+int run_batch(const char *path, int jobs)
+{
+    struct timeval start;
+    gettimeofday(&start, NULL);
+
+    const char *data;
+    size_t size, n;
+    level_t *levels;
+    if (!map_levels(path, &data, &size, &levels, &n))
+        return 2;
+
+    level_t **order = malloc(n * sizeof(level_t *));
+    char **solution = calloc(n, sizeof(char *));
+    int *status = malloc(n * sizeof(int));
+    double *ms = malloc(n * sizeof(double));
+    pthread_t *pool = malloc(jobs * sizeof(pthread_t));
+    assert(order && solution && status && ms && pool);
+    for (size_t i = 0; i < n; i++)
+        order[i] = &levels[i];
+    qsort(order, n, sizeof(level_t *), by_cost);
+
+    // Os núcleos são divididos entre as threads do grupo; com muitos níveis, uma thread do OpenMP cada
+    if ((size_t)jobs > n)
+        jobs = n;
+    const int threads = omp_get_max_threads() / jobs > 1 ? omp_get_max_threads() / jobs : 1;
+    printf("%zu níveis, %d threads com %d thread(s) do OpenMP cada\n", n, jobs, threads);
+    fflush(stdout);
+
+    batch_t b = {.options = sk, .order = order, .n = n, .threads = threads, .solution = solution, .status = status, .ms = ms};
+    for (int t = 0; t < jobs; t++)
+        if (pthread_create(&pool[t], NULL, batch_worker, &b))
+        {
+            perror("pthread_create");
+            return 2;
+        }
+    for (int t = 0; t < jobs; t++)
+        pthread_join(pool[t], NULL);
+
+    int solved = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        printf("Nível %zu (%.1f ms): ", i + 1, ms[i]);
+        if (!status[i] && solution[i])
+            printf("%s", solution[i]), solved++;
+        else if (status[i] == 1)
+            printf("Sem solução\n");
+        else
+            printf("Erro (código %d)\n", status[i]);
+        free(solution[i]);
+    }
+    printf("Níveis resolvidos: %d de %zu\n", solved, n);
+    printf("Tempo total gasto = %g ms\n", ms_since(&start));
+
+    free(order);
+    free(solution);
+    free(status);
+    free(ms);
+    free(pool);
+    unmap_levels(data, size, levels);
+    return solved == (int)n ? 0 : 1;
+}
+
+/*----------- Biblioteca (sokoban.h) -----------*/
+
+/* Com -DSOKOBAN_LIB o arquivo vira a libsokoban: sem main, com só as funções de sokoban.h visíveis
+   (o resto fica escondido com -fvisibility=hidden). Todo o estado de uma resolução está no contexto
+   apontado por sk, que é threadprivate: cada thread do programa que chama sokoban_solve aponta o
+   seu sk para o próprio contexto, e as regiões paralelas o copiam para a equipe com copyin(sk).
+   O limite de memória (-M) e os checkpoints (-c, -r) ficam só no programa: o limite termina o
+   processo quando estoura, e os checkpoints gravam um arquivo por execução. Os outros erros da
+   busca (arquivos de -e, combinações de metas demais em -b, caminho que não pôde ser refeito) só
+   marcam failed, que vira SOKOBAN_ERROR. */
+
+// Combinações de opções inválidas: retorna a mensagem, ou NULL se as opções de sk valem
+static const char *check_options()
+{
+    if (sk->astar_mode && sk->bidirectional)
+        return "As opções -a e -b não podem ser usadas juntas";
+    if (sk->ida_mode && (sk->astar_mode || sk->bidirectional || sk->external))
+        return "A opção -i não pode ser usada com -a, -b ou -e";
+    if (sk->pdb_k && !sk->astar_mode && !sk->ida_mode)
+        return "A opção -g só funciona com -a ou -i";
+    if (sk->lean && (sk->astar_mode || sk->ida_mode || sk->bidirectional || sk->external))
+        return "A opção -l não pode ser usada com -a, -i, -b ou -e";
+    if (sk->macros && (sk->ida_mode || sk->bidirectional || sk->external))
+        return "A opção -u não pode ser usada com -i, -b ou -e";
+    if (sk->external && (sk->push_mode || sk->astar_mode))
+        return "A busca em disco (-e) só funciona na busca por passos (sem -p, -a ou -b)";
+    return NULL;
+}
+
+// Cria um contexto com os padrões da linha de comando
+SOKOBAN_API sokoban_t *sokoban_new(void)
+{
+    sokoban_t *ctx = calloc(1, sizeof(sokoban_t));
+    if (!ctx)
+        return NULL;
+    ctx->deadlock_checks = (1 << N_DEADLOCK) - 1;
+    ctx->ckp_interval = 300;
+    ctx->ext_budget = (size_t)256 << 20;
+    static unsigned n_contexts;
+    ctx->id = __atomic_fetch_add(&n_contexts, 1, __ATOMIC_RELAXED);
+    return ctx;
+}
+
+// Libera o contexto
+SOKOBAN_API void sokoban_free(sokoban_t *ctx)
+{
+    free(ctx); // O nível resolvido já foi liberado no fim de sokoban_solve
+}
+
+// Opções padrão: busca em largura por passos, com todos os testes de deadlock
+SOKOBAN_API void sokoban_defaults(sokoban_options_t *opt)
+{
+    memset(opt, 0, sizeof(*opt));
+    opt->deadlocks = SOKOBAN_DL_FREEZE | SOKOBAN_DL_SQUARE | SOKOBAN_DL_MATCH;
+}
+
+// Resolve o primeiro nível de `level` no contexto ctx, com a equipe do OpenMP da thread que chama
+SOKOBAN_API int sokoban_solve(sokoban_t *ctx, const char *level, const sokoban_options_t *opt, sokoban_result_t *res)
+{
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    memset(res, 0, sizeof(*res));
+
+    // O contexto recomeça dos padrões a cada resolução; os bits de SOKOBAN_DL_* são os de DL_*
+    memset(ctx, 0, offsetof(sokoban_t, id));
+    ctx->ckp_interval = 300;
+    ctx->push_mode = opt->push || opt->macros || opt->bidirectional;
+    ctx->macros = opt->macros;
+    ctx->bidirectional = opt->bidirectional;
+    ctx->astar_mode = opt->astar;
+    ctx->ida_mode = opt->ida;
+    ctx->lean = opt->lean;
+    ctx->external = opt->external != NULL;
+    ctx->ext_dir = opt->external;
+    ctx->ext_budget = opt->budget ? opt->budget : (size_t)256 << 20;
+    ctx->deadlock_checks = opt->deadlocks & ((1 << N_DEADLOCK) - 1);
+    ctx->pdb_k = opt->patterns;
+    ctx->cache_dir = opt->cache;
+    sk = ctx;
+
+    level_t *levels;
+    const size_t n = index_levels(level, strlen(level), &levels);
+    const char *err = check_options();
+    if (!err && (ctx->lean < 0 || ctx->pdb_k < 0 || ctx->pdb_k > 4))
+        err = "Número de camadas (-l) ou tamanho de padrão (-g) inválido";
+    if (!err && !n)
+        err = "Nenhum nível no texto dado";
+    if (err)
+    {
+        fprintf(stderr, "%s\n", err);
+        free(levels);
+        sk = NULL;
+        return SOKOBAN_INVALID;
+    }
+    char *text = pad_level(levels[0].text, levels[0].len);
+    free(levels);
+    if ((err = level_error(text)))
+    {
+        fprintf(stderr, "%s\n", err);
+        free(text);
+        sk = NULL;
+        return SOKOBAN_INVALID;
+    }
+
+    // A equipe da resolução tem opt->threads threads; o padrão da thread que chama volta no fim
+    const int threads = omp_get_max_threads();
+    if (opt->threads > 0)
+        omp_set_num_threads(opt->threads);
+    solve(text);
+    omp_set_num_threads(threads);
+
+    if (solved())
+    {
+        size_t len;
+        FILE *out = open_memstream(&res->moves, &len);
+        assert(out);
+        show_solution(out);
+        fclose(out);
+        if (ctx->failed) // Caminho inconsistente: a saída parcial não vale
+        {
+            free(res->moves);
+            res->moves = NULL;
+        }
+        else if (len && res->moves[len - 1] == '\n')
+            res->moves[len - 1] = '\0';
+    }
+    res->visited = visited_states();
+    res->expanded = ctx->expanded;
+
+    const bool failed = ctx->failed;
+
+    release_level();
+    free(text);
+    sk = NULL;
+    res->ms = ms_since(&start);
+    return failed ? SOKOBAN_ERROR : res->moves ? SOKOBAN_OK : SOKOBAN_UNSOLVABLE;
+}
+
+// Libera a solução de res
+SOKOBAN_API void sokoban_result_free(sokoban_result_t *res)
+{
+    free(res->moves);
+    res->moves = NULL;
+}
+
+#ifndef SOKOBAN_LIB
+int main(int argc, char *argv[])
+{
+    // Contexto do programa, com os padrões das opções
+    sk = sokoban_new();
+    assert(sk);
+
     // Variáveis para medir o tempo de execução
-    struct timeval start, stop;
+    struct timeval start;
+
+    // Opções de linha de comando
+    const char *batch = NULL; // coleção de níveis do modo em lote (-f)
+    int jobs = omp_get_num_procs();
+    int opt;
+#ifdef TELEMETRY
+    const char *optstring = "pbuaig:l:d:f:j:e:m:M:k:c:s:r:t:";
+#else
+    const char *optstring = "pbuaig:l:d:f:j:e:m:M:k:c:s:r:";
+#endif
+    static const struct option longopts[] = {
+        {"checkpoint", required_argument, NULL, 'c'},
+        {"checkpoint-interval", required_argument, NULL, 's'},
+        {"resume", required_argument, NULL, 'r'},
+        {"memory-limit", required_argument, NULL, 'M'},
+        {"cache", required_argument, NULL, 'k'},
+        {NULL, 0, NULL, 0}};
+    while ((opt = getopt_long(argc, argv, optstring, longopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': // Busca no espaço de empurrões (jogador normalizado)
+            sk->push_mode = true;
+            break;
+        case 'b': // Busca bidirecional: empurrões a partir do início e puxadas a partir das metas
+            sk->push_mode = sk->bidirectional = true;
+            break;
+        case 'u': // Empurrões em macro por túneis e salas de metas
+            sk->push_mode = sk->macros = true;
+            break;
+        case 'a': // Busca A* com heurística de atribuição caixas-metas
+            sk->astar_mode = true;
+            break;
+        case 'i': // Busca IDA* paralela, com a mesma heurística e memória limitada
+            sk->ida_mode = true;
+            break;
+        case 'g': // Banco de padrões de N caixas na heurística do A* e do IDA*
+            sk->pdb_k = atoi(optarg);
+            if (sk->pdb_k < 1 || sk->pdb_k > 4)
+            {
+                fprintf(stderr, "Tamanho de padrão inválido (de 1 a 4): %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'l': // Busca em largura só com as últimas camadas, refazendo o caminho por divisão e conquista
+            sk->lean = atoi(optarg);
+            if (sk->lean < 1)
+            {
+                fprintf(stderr, "Número de camadas inválido: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'd': // Testes de deadlock ativos: f (congelamento), q (bloco 2x2), m (emparelhamento), n (nenhum)
+            sk->deadlock_checks = 0;
+            for (const char *k = optarg; *k; k++)
+            {
+                if (*k == 'f')
+                    sk->deadlock_checks |= 1 << DL_FREEZE;
+                else if (*k == 'q')
+                    sk->deadlock_checks |= 1 << DL_SQUARE;
+                else if (*k == 'm')
+                    sk->deadlock_checks |= 1 << DL_MATCH;
+                else if (*k != 'n')
+                {
+                    fprintf(stderr, "Teste de deadlock desconhecido: %c\n", *k);
+                    return 2;
+                }
+            }
+            break;
+        case 'f': // Modo em lote: resolve todos os níveis do arquivo
+            batch = optarg;
+            break;
+        case 'j': // Níveis resolvidos ao mesmo tempo no modo em lote
+            jobs = atoi(optarg);
+            if (jobs < 1)
+            {
+                fprintf(stderr, "Número de threads inválido: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'e': // Busca em largura em disco, com os arquivos de trabalho no diretório dado
+            sk->external = true;
+            sk->ext_dir = optarg;
+            break;
+        case 'm': // Memória para os buffers da busca em disco ou a tabela de transposição do IDA*, em MiB
+            sk->ext_budget = (size_t)atol(optarg) << 20;
+            if (!sk->ext_budget)
+            {
+                fprintf(stderr, "Orçamento de memória inválido: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'M': // Limite de memória para os blocos de estados e as tabelas, em MiB
+            sk->mem_limit = (size_t)atol(optarg) << 20;
+            if (!sk->mem_limit)
+            {
+                fprintf(stderr, "Limite de memória inválido: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'k': // Cache da análise dos níveis no diretório dado
+            sk->cache_dir = optarg;
+            break;
+        case 'c': // Grava checkpoints da busca em largura no arquivo dado
+            sk->ckp_path = optarg;
+            break;
+        case 's': // Segundos entre checkpoints
+            sk->ckp_interval = atof(optarg);
+            if (sk->ckp_interval < 0)
+            {
+                fprintf(stderr, "Intervalo de checkpoint inválido: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'r': // Continua a busca em largura a partir de um checkpoint
+            sk->resume_path = optarg;
+            break;
+#ifdef TELEMETRY
+        case 't': // Grava o trace da busca (formato de eventos do Chrome)
+            sk->trace_path = optarg;
+            break;
+#endif
+        default:
+            fprintf(stderr, "Uso: %s [-p] [-u] [-b | -a | -i [-m MiB] | -l N | -e dir [-m MiB]] [-g N] [-d fqm] [-M MiB] [-k dir] [-c arquivo [-s segundos]] [-f arquivo [-j N] | -r arquivo | nível]\n", argv[0]);
+            fprintf(stderr, "  -p  busca por empurrões, com a posição do jogador normalizada\n");
+            fprintf(stderr, "  -u  empurrões em macro: atravessa túneis e leva a caixa da porta de uma sala de metas\n");
+            fprintf(stderr, "      direto à meta (implica -p; camadas mais curtas, solução não ótima em empurrões)\n");
+            fprintf(stderr, "  -b  busca bidirecional (empurrões do início e puxadas das metas, implica -p)\n");
+            fprintf(stderr, "  -a  busca A* (ótima em passos, ou em empurrões com -p)\n");
+            fprintf(stderr, "  -i  busca IDA* paralela com tabela de transposição (ótima como o A*, memória limitada)\n");
+            fprintf(stderr, "  -g  soma bancos de padrões de N caixas (1 a 4) na heurística do -a e do -i\n");
+            fprintf(stderr, "  -l  busca em largura guardando só as N últimas camadas (memória da fronteira, mais tempo)\n");
+            fprintf(stderr, "  -d  testes de deadlock ativos: f congelamento, q bloco 2x2, m emparelhamento,\n");
+            fprintf(stderr, "      n nenhum (padrão: fqm)\n");
+            fprintf(stderr, "  -f  resolve todos os níveis de uma coleção (formato XSB)\n");
+            fprintf(stderr, "  -j  níveis resolvidos ao mesmo tempo no modo em lote, um por thread (padrão: número de núcleos)\n");
+            fprintf(stderr, "  -e  busca em largura em disco (arquivos de trabalho no diretório dado)\n");
+            fprintf(stderr, "  -m  memória dos buffers da busca em disco ou da tabela do IDA*, em MiB (padrão: 256)\n");
+            fprintf(stderr, "  -M  limite de memória para os estados e as tabelas de hash, em MiB (--memory-limit)\n");
+            fprintf(stderr, "  -k  guarda a análise de cada nível (células vivas, distâncias) no diretório dado (--cache)\n");
+            fprintf(stderr, "  -c  grava checkpoints da busca em largura no arquivo dado (--checkpoint)\n");
+            fprintf(stderr, "  -s  segundos entre checkpoints (--checkpoint-interval, padrão: 300)\n");
+            fprintf(stderr, "  -r  continua a busca em largura de um checkpoint, com o nível e o modo dele (--resume)\n");
+            fprintf(stderr, "  nível: arquivo cujo primeiro nível é resolvido no lugar do tabuleiro embutido\n");
+#ifdef TELEMETRY
+            fprintf(stderr, "  -t  grava o trace da busca (chrome://tracing) no arquivo dado\n");
+#endif
+            return 2;
+        }
+    }
+    const char *err = check_options();
+    if (err)
+    {
+        fprintf(stderr, "%s\n", err);
+        return 2;
+    }
+    if ((sk->ckp_path || sk->resume_path) && (sk->astar_mode || sk->ida_mode || sk->bidirectional || sk->external || sk->lean || batch))
+    {
+        fprintf(stderr, "Checkpoints (-c, -r) só funcionam na busca em largura (sem -a, -i, -b, -e, -l ou -f)\n");
+        return 2;
+    }
+    if (sk->mem_limit && batch)
+    {
+        fprintf(stderr, "O limite de memória (-M) não funciona no modo em lote (-f)\n");
+        return 2;
+    }
+#ifdef USE_MPI
+    // Todos os processos leem o mesmo nível e resolvem a sua parte; só o processo 0 escreve a saída
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    atexit(mpi_finish);
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+    sk->distributed = n_ranks > 1;
+    if (batch || (sk->distributed && (sk->astar_mode || sk->ida_mode || sk->external || sk->bidirectional || sk->lean || sk->ckp_path || sk->resume_path)))
+    {
+        if (!mpi_rank)
+            fprintf(stderr, "A busca distribuída só funciona na busca em largura (sem -a, -i, -e, -b, -l, -c, -r ou -f)\n");
+        return 2;
+    }
+    if (mpi_rank && !freopen("/dev/null", "w", stdout))
+        return 2;
+#endif
+    if (batch)
+        return run_batch(batch, jobs);
 
-    // Representação do tabuleiro como uma string
+    // Representação do tabuleiro como uma string (ou o primeiro nível do arquivo dado na linha de comando)
     const char *boardStr =
         "#######################\n"
         "#. #####......##...####\n"
@@ -455,85 +5459,94 @@ int main()
         "######.$$...$$$.#     #\n"
         "#.#. #.#             @#\n"
         "#######################\n";
+    size_t boardLen = strlen(boardStr);
+
+    const char *data = NULL;
+    size_t size = 0, n_levels;
+    level_t *levels = NULL;
+    char *resumed = NULL;
+    if (sk->resume_path) // O nível vem do checkpoint
+    {
+        boardStr = resumed = ckp_read_level();
+        boardLen = strlen(resumed);
+    }
+    else if (optind < argc)
+    {
+        if (!map_levels(argv[optind], &data, &size, &levels, &n_levels))
+            return 2;
+        boardStr = levels[0].text;
+        boardLen = levels[0].len;
+    }
 
     // Imprime o tabuleiro no formato de string
-    printf("%s\n", boardStr);
+    printf("%.*s\n", (int)boardLen, boardStr);
 
     // Inicia a medição do tempo
     gettimeofday(&start, NULL);
 
-    // Determina a largura (w) e altura (h) do tabuleiro a partir da string
-    w = 0;
-    h = 0;
-    for (int i = 0; boardStr[i] != '\0'; i++)
+    // Determina a largura (w) e altura (h) do tabuleiro; linhas mais curtas são completadas com espaço
+    char *level = pad_level(boardStr, boardLen);
+    unmap_levels(data, size, levels);
+    free(resumed);
+    printf("Tamanho do mapa: %d x %d\n", sk->w, sk->h);
+    if ((err = level_error(level)))
     {
-        // Conta o número de linhas no tabuleiro (indicados por '\n')
-        if (boardStr[i] == '\n')
-        {
-            h++; // Incrementa a altura
-        }
-        // Conta o número de caracteres na primeira linha (largura do tabuleiro)
-        else if (h == 0)
-        {
-            w++; // Incrementa a largura apenas na primeira linha
-        }
+        fprintf(stderr, "%s\n", err);
+        return 2;
     }
-    w++; // A largura deve ser incrementada por causa do caractere '\0' no final
-
-    // Faz o parsing da string para o estado inicial do tabuleiro
-    state_t *s = parse_board(boardStr);
-    printf("Tamanho do mapa: %d x %d\n", w, h);
 
-    // Expande a tabela de hash se necessário
-    extend_table();
-    // Adiciona o estado inicial à fila de movimentos
-    queue_move(s);
+    solve(level);
+    if (sk->failed) // A mensagem já foi impressa (arquivos da busca em disco, combinações de metas de -b)
+        return 2;
 
-    // Enquanto o jogo não for resolvido, continua tentando encontrar a solução
-    while (!done) // Enquanto não tiver terminado
+    // Se não houver mais estados para explorar, significa que não há solução
+    if (!solved())
     {
-        state_t *head = next_level;
-        // Itera sobre os estados na próxima camada
-        for (next_level = NULL; head && !done; head = head->qnext)
-            do_move(head); // Realiza um movimento no estado atual
-
-        // Se não houver mais estados para explorar, significa que não há solução
-        if (!next_level)
-        {
-            puts("Sem solução");
-            return 1; // Retorna com erro se não houver solução
-        }
+        puts("Sem solução");
+        return 1; // Retorna com erro se não houver solução
     }
 
     // Imprime os movimentos que levaram à solução
+    printf("Estados visitados: %zu\n", visited_states());
+#ifdef USE_MPI
+    for (int r = 0; sk->distributed && r < n_ranks; r++)
+        printf("Processo %d: %llu estados\n", r, sk->mpi_filled[r]);
+#endif
+    if (sk->astar_mode)
+        printf("Estados expandidos: %zu\n", sk->expanded);
+    if (sk->pdb_k)
+        printf("Banco de padrões de %d caixas: %zu estados, %g ms\n", sk->pdb_k, sk->pdb_states, sk->pdb_ms);
+    print_arena_stats();
+    print_deadlock_stats();
+#ifdef TELEMETRY
+    print_layer_stats();
+    if (sk->trace_path)
+        write_trace(sk->trace_path);
+#endif
     printf("\nMovimentos: \n");
-    show_moves(done, -1); // Mostra a sequência de movimentos
+    show_solution(stdout);
+    if (sk->failed) // Caminho inconsistente (mensagem já em stderr)
+        return 2;
 
     // Libera a memória alocada para as estruturas de dados
-    free(buckets); // Libera a tabela de hash
-    free(board);   // Libera o tabuleiro
-    free(goals);   // Libera os objetivos
-    free(live);    // Libera a lista de estados vivos
-
-    // Libera a memória de blocos encadeados
-    while (block_root)
-    {
-        void *tmp = block_root->next;
-        free(block_root); // Libera o bloco atual
-        block_root = tmp; // Avança para o próximo bloco
-    }
+    release_level();
+    free(level);
 
-    // Finaliza a medição do tempo
-    gettimeofday(&stop, NULL);
-    // Calcula o tempo total gasto em milissegundos
-    double tempo =
-        (((double)(stop.tv_sec) * 1000.0 + (double)(stop.tv_usec / 1000.0)) -
-         ((double)(start.tv_sec) * 1000.0 + (double)(start.tv_usec / 1000.0)));
-    // Exibe o tempo total de execução
-    fprintf(stdout, "Tempo total gasto = %g ms\n", tempo);
+    // Exibe o tempo total de execução e o pico de memória do processo
+    fprintf(stdout, "Tempo total gasto = %g ms\n", ms_since(&start));
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    long peak = ru.ru_maxrss;
+#ifdef USE_MPI
+    if (sk->distributed) // O maior pico entre os processos
+        MPI_Allreduce(MPI_IN_PLACE, &peak, 1, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+#endif
+    printf("Pico de memória: %ld KB\n", peak);
 
+    sokoban_free(sk);
     return 0;
 }
+#endif
 
 /*
 Input para teste rapido:
@@ -567,4 +5580,16 @@ const char *boardStr =
 Movimentos:
 llllllllURuLdLUUrUdllllDLrrddllULrUU
 
+Mais caixas que metas (todos os modos, inclusive -a e -i, devem dizer "Sem solução" na hora)
+
+#######
+#     #
+# $$  #
+#  . @#
+#######
+
+Output:
+
+Sem solução
+
 */
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include <stdbool.h>
 
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <math.h>
 
 int w, h, n_boxes;             // largura (w), altura (h) e número de caixas (n_boxes)
@@ -392,10 +393,57 @@ void show_moves(const state_t *s, int nextPos)
     }
 }
 
-int main()
+// Lê o primeiro nível do arquivo (linhas cujo primeiro caractere não branco é '#') e o devolve com
+// todas as linhas da largura da maior, completadas com espaço, como espera o cálculo de w em main
+char *read_level(const char *path)
 {
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
 
-    // Substitua esta parte pelo seu tabuleiro como string
+    char line[1024];
+    char *rows[256];
+    int n = 0, max = 0;
+    while (n < 256 && fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        const char *c = line + strspn(line, " \t");
+        if (*c != '#')
+        {
+            if (n)
+                break; // Fim do primeiro nível
+            continue;
+        }
+        rows[n] = strdup(line);
+        assert(rows[n]);
+        if ((int)strlen(line) > max)
+            max = strlen(line);
+        n++;
+    }
+    fclose(f);
+    if (!n)
+    {
+        fprintf(stderr, "Nenhum nível em %s\n", path);
+        exit(2);
+    }
+
+    char *b = malloc((max + 1) * n + 1), *p = b;
+    assert(b);
+    for (int i = 0; i < n; i++)
+    {
+        p += sprintf(p, "%-*s\n", max, rows[i]);
+        free(rows[i]);
+    }
+    return b;
+}
+
+int main(int argc, char *argv[])
+{
+
+    // Substitua esta parte pelo seu tabuleiro como string (ou passe um arquivo de nível como argumento)
     const char *boardStr =
         "#######################\n"
         "#. #####......##...####\n"
@@ -405,6 +453,8 @@ int main()
         "######.$$...$$$.#     #\n"
         "#.#. #.#             @#\n"
         "#######################\n";
+    if (argc > 1)
+        boardStr = read_level(argv[1]);
 
     printf("%s", boardStr);
 
@@ -442,13 +492,14 @@ int main()
         for (next_level = NULL; head && !done; head = head->qnext)
             do_move(head); // Perform moves
 
-        if (!next_level)
+        if (!done && !next_level) // O estado final não entra na fila, então a camada pode ficar vazia
         {
             puts("sem solução?");
             return 1; // If no solution found, exit the program
         }
     }
 
+    printf("Estados visitados: %u\n", filled);
     printf("\nMovimentos: \n");
     show_moves(done, -1); // Show the sequence of moves that lead to the solution
 
@@ -472,6 +523,11 @@ int main()
          ((double)(start.tv_sec) * 1000.0 + (double)(start.tv_usec / 1000.0)));
     fprintf(stdout, "Tempo total gasto = %g ms\n", tempo);
 
+    // Pico de memória do processo
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("Pico de memória: %ld KB\n", ru.ru_maxrss);
+
     return 0;
 }
 
@@ -0,0 +1,92 @@
+/*
+ * libsokoban: o resolvedor de sokoban-paralelizado.c como biblioteca (make libsokoban.a ou
+ * make libsokoban.so).
+ *
+ * Todo o estado de uma resolução fica num contexto (sokoban_t): o nível, as arenas de estados,
+ * as tabelas e as threads do OpenMP que ele usa. Contextos diferentes não compartilham nada, então
+ * várias threads do programa podem resolver níveis ao mesmo tempo, cada uma com o seu contexto,
+ * sem travas; um mesmo contexto só pode ser usado por uma thread de cada vez. Cada resolução
+ * abre a sua própria equipe do OpenMP, então chame sokoban_solve de threads do programa
+ * (pthreads), não de dentro de uma região paralela.
+ *
+ * Uso:
+ *     sokoban_t *ctx = sokoban_new();
+ *     sokoban_options_t opt;
+ *     sokoban_result_t res;
+ *     sokoban_defaults(&opt);
+ *     opt.astar = true;
+ *     if (sokoban_solve(ctx, nivel, &opt, &res) == SOKOBAN_OK)
+ *         puts(res.moves);
+ *     sokoban_result_free(&res);
+ *     sokoban_free(ctx);
+ */
+#ifndef SOKOBAN_H
+#define SOKOBAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SOKOBAN_API __attribute__((visibility("default")))
+
+// Contexto de resolução (opaco)
+typedef struct sokoban sokoban_t;
+
+// Testes de deadlock (campo deadlocks das opções, como -d)
+#define SOKOBAN_DL_FREEZE 1 // caixas congeladas fora de meta (f)
+#define SOKOBAN_DL_SQUARE 2 // blocos 2x2 sem saída (q)
+#define SOKOBAN_DL_MATCH 4  // falta de emparelhamento caixa-meta (m)
+
+// Opções de uma resolução: as mesmas da linha de comando, com as mesmas combinações válidas
+typedef struct
+{
+    bool push;            // busca por empurrões (-p)
+    bool macros;          // empurrões em macro (-u, implica push)
+    bool bidirectional;   // busca bidirecional (-b, implica push)
+    bool astar;           // busca A* (-a)
+    bool ida;             // busca IDA* (-i)
+    int lean;             // busca em largura só com as N últimas camadas (-l; 0 = normal)
+    const char *external; // busca em disco com os arquivos neste diretório (-e; NULL = em memória)
+    size_t budget;        // memória dos buffers de -e ou da tabela do IDA*, em bytes (-m)
+    unsigned deadlocks;   // testes de deadlock ativos (SOKOBAN_DL_*, -d)
+    int patterns;         // caixas por padrão do banco de padrões (-g; 0 = sem banco)
+    const char *cache;    // diretório do cache da análise e dos bancos (-k; NULL = sem cache)
+    int threads;          // threads do OpenMP (0 = omp_get_max_threads da thread que chama)
+} sokoban_options_t;
+
+// Resultado de uma resolução
+typedef struct
+{
+    char *moves;     // movimentos (letras lrud, maiúsculas nos empurrões), ou NULL sem solução
+    size_t visited;  // estados visitados
+    size_t expanded; // estados expandidos (A*)
+    double ms;       // tempo da resolução
+} sokoban_result_t;
+
+// Retornos de sokoban_solve
+enum
+{
+    SOKOBAN_OK,         // resolvido; a solução está em moves
+    SOKOBAN_UNSOLVABLE, // o nível não tem solução
+    SOKOBAN_INVALID,    // nível vazio ou combinação de opções inválida (mensagem em stderr)
+    SOKOBAN_ERROR       // a busca parou por um erro, como um arquivo de -e que não pôde ser gravado,
+                        // combinações de metas demais para -b ou um caminho que não pôde ser refeito
+                        // (mensagem em stderr)
+};
+
+// Cria um contexto; retorna NULL se faltar memória
+SOKOBAN_API sokoban_t *sokoban_new(void);
+
+// Libera o contexto (as resoluções não deixam nada nele)
+SOKOBAN_API void sokoban_free(sokoban_t *ctx);
+
+// Preenche opt com os padrões da linha de comando (busca em largura por passos, todos os testes)
+SOKOBAN_API void sokoban_defaults(sokoban_options_t *opt);
+
+// Resolve o primeiro nível do texto `level` (formato XSB) com as opções dadas e preenche res
+// Retorna SOKOBAN_OK, SOKOBAN_UNSOLVABLE, SOKOBAN_INVALID ou SOKOBAN_ERROR
+SOKOBAN_API int sokoban_solve(sokoban_t *ctx, const char *level, const sokoban_options_t *opt, sokoban_result_t *res);
+
+// Libera a solução de res
+SOKOBAN_API void sokoban_result_free(sokoban_result_t *res);
+
+#endif